@@ -0,0 +1,98 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreLdapArena.h
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef _QORE_QORELDAPARENA_H
+
+#define _QORE_QORELDAPARENA_H
+
+#include <string.h>
+
+#include <cstddef>
+#include <vector>
+
+// the size of the arena block allocated with the arena itself in bytes; enough for most single-entry requests
+#define QORE_LDAP_ARENA_INLINE_SIZE 1024
+// the size of each additional arena block in bytes
+#define QORE_LDAP_ARENA_BLOCK_SIZE 8192
+
+// a bump allocator for the arrays and values of a single request
+/** memory is only freed when the arena is destroyed; objects allocated from the arena must not need destruction
+*/
+class QoreLdapArena {
+public:
+    DLLLOCAL QoreLdapArena() : pos(buf), avail(sizeof buf) {
+    }
+
+    DLLLOCAL ~QoreLdapArena() {
+        for (auto& i : blocks)
+            delete [] i;
+    }
+
+    // returns uninitialized memory for the given number of objects of the given type
+    template <typename T>
+    DLLLOCAL T* alloc(size_t n) {
+        return static_cast<T*>(allocBytes(sizeof(T) * n));
+    }
+
+    // returns a NUL-terminated copy of the given data
+    DLLLOCAL char* copy(const void* p, size_t len) {
+        char* rv = alloc<char>(len + 1);
+        memcpy(rv, p, len);
+        rv[len] = '\0';
+        return rv;
+    }
+
+private:
+    alignas(std::max_align_t) char buf[QORE_LDAP_ARENA_INLINE_SIZE];
+    // the next free byte in the current block and the number of bytes available after it
+    char* pos;
+    size_t avail;
+    // additional blocks allocated on the heap
+    std::vector<char*> blocks;
+
+    DLLLOCAL void* allocBytes(size_t size) {
+        // keep all allocations aligned for any type
+        size = (size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+        if (size > avail) {
+            // allocations larger than a block get their own block, and the current block remains in use
+            if (size > QORE_LDAP_ARENA_BLOCK_SIZE) {
+                char* b = new char[size];
+                blocks.push_back(b);
+                return b;
+            }
+            pos = new char[QORE_LDAP_ARENA_BLOCK_SIZE];
+            blocks.push_back(pos);
+            avail = QORE_LDAP_ARENA_BLOCK_SIZE;
+        }
+        void* rv = pos;
+        pos += size;
+        avail -= size;
+        return rv;
+    }
+
+    DLLLOCAL QoreLdapArena(const QoreLdapArena&) = delete;
+    DLLLOCAL QoreLdapArena& operator=(const QoreLdapArena&) = delete;
+};
+
+#endif
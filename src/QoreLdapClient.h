@@ -26,11 +26,26 @@
 #define _QORE_QORELDAPCLIENT_H
 
 #include <ldap.h>
+#include <ldap_schema.h>
+
+#include "QoreLdapArena.h"
+#include "QoreLdapLdif.h"
+#include "QoreLdapSearchCache.h"
+#include "QoreLdapServerSet.h"
+#include "QoreLdapStats.h"
 
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 
+#include <atomic>
+#include <deque>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 // default ldap operation timeout in milliseconds
 #define QORE_LDAP_DEFAULT_TIMEOUT_MS 60000
@@ -38,6 +53,16 @@
 // default ldap protocol version
 #define QORE_LDAP_DEFAULT_PROTOCOL 3
 
+// the persistent search control and entry change notification control (draft-ietf-ldapext-psearch)
+#ifndef LDAP_CONTROL_PERSIST_REQUEST
+#define LDAP_CONTROL_PERSIST_REQUEST "2.16.840.1.113730.3.4.3"
+#define LDAP_CONTROL_PERSIST_ENTRY_CHANGE_NOTICE "2.16.840.1.113730.3.4.7"
+#define LDAP_CONTROL_PERSIST_ENTRY_CHANGE_ADD 0x1
+#define LDAP_CONTROL_PERSIST_ENTRY_CHANGE_DELETE 0x2
+#define LDAP_CONTROL_PERSIST_ENTRY_CHANGE_MODIFY 0x4
+#define LDAP_CONTROL_PERSIST_ENTRY_CHANGE_RENAME 0x8
+#endif
+
 template<typename T>
 DLLLOCAL const T* check_hash_key(ExceptionSink *xsink, const QoreHashNode& h, const char* key, const char* err, const char* hash_name = 0) {
     QoreValue p = h.getKeyValue(key);
@@ -54,275 +79,226 @@ DLLLOCAL const T* check_hash_key(ExceptionSink *xsink, const QoreHashNode& h, co
     return p.get<const T>();
 }
 
+// base class for NULL-terminated arrays built for a single request; the array and all values are allocated in the
+// helper's arena and freed together
 template <typename T>
 class LdapListHelper {
-protected:
-   T* l;
-   size_t len;
-
-   DLLLOCAL virtual int addElement(const ConstListIterator& li, ExceptionSink* xsink) = 0;
-
-   DLLLOCAL LdapListHelper() : l(0), len(0) {
-   }
-
-   DLLLOCAL int init(const QoreListNode* ql, ExceptionSink* xsink) {
-      // convert list to attribute list
-      if (!ql || ql->empty())
-         return 0;
-
-      len = ql->size();
-
-      l = new T[ql->size() + 1];
-      ConstListIterator li(ql);
-      while (li.next()) {
-         if (addElement(li, xsink)) {
-            len = li.index();
-            return -1;
-         }
-      }
-      // terminate list with a 0
-      l[li.max()] = 0;
-      return 0;
-   }
-
 public:
-   DLLLOCAL virtual ~LdapListHelper() {
-   }
-
-   DLLLOCAL T* operator*() const {
-      return l;
-   }
-
-   DLLLOCAL size_t size() const {
-      return len;
-   }
-};
+    DLLLOCAL T* operator*() const {
+        return l;
+    }
 
-class QoreBerval : public berval {
-public:
-   DLLLOCAL QoreBerval(const QoreString& str) {
-      bv_val = new char[str.size() + 1];
-      strcpy(bv_val, str.getBuffer());
-      bv_len = str.size();
-   }
-
-   DLLLOCAL ~QoreBerval() {
-      delete [] bv_val;
-   }
-};
+    DLLLOCAL size_t size() const {
+        return len;
+    }
 
-class BervalListHelper : public LdapListHelper<QoreBerval*> {
 protected:
-   DLLLOCAL virtual int addElement(const ConstListIterator& li, ExceptionSink* xsink) {
-      QoreStringValueHelper str(li.getValue(), QCS_UTF8, xsink);
-      if (*xsink)
-         return -1;
-      QoreBerval*& e = l[li.index()];
-      e = new QoreBerval(**str);
-      return 0;
-   }
+    QoreLdapArena arena;
+    T* l = nullptr;
+    size_t len = 0;
 
-public:
-   DLLLOCAL BervalListHelper(const QoreListNode* strl, ExceptionSink* xsink) : LdapListHelper<QoreBerval*>() {
-      init(strl, xsink);
-   }
-
-   DLLLOCAL virtual ~BervalListHelper() {
-      for (unsigned i = 0; i < len; ++i)
-         delete l[i];
-      delete [] l;
-   }
-};
+    DLLLOCAL LdapListHelper() {
+    }
 
-class AttrListHelper : public LdapListHelper<char*> {
-protected:
-   DLLLOCAL virtual int addElement(const ConstListIterator& li, ExceptionSink* xsink) {
-      QoreStringValueHelper str(li.getValue(), QCS_UTF8, xsink);
-      if (*xsink)
-         return -1;
-      char*& e = l[li.index()];
-      e = new char[str->size() + 1];
-      strcpy(e, str->getBuffer());
-      return 0;
-   }
+    // allocates the array for the given number of elements and terminates it with a 0
+    DLLLOCAL void initList(size_t n) {
+        l = arena.alloc<T>(n + 1);
+        memset(l, 0, sizeof(T) * (n + 1));
+        len = n;
+    }
 
-public:
-   DLLLOCAL AttrListHelper(const QoreListNode* attrl, ExceptionSink* xsink) : LdapListHelper<char*>() {
-      init(attrl, xsink);
-   }
-
-   DLLLOCAL virtual ~AttrListHelper() {
-      for (unsigned i = 0; i < len; ++i)
-         delete [] l[i];
-      delete [] l;
-   }
+private:
+    DLLLOCAL LdapListHelper(const LdapListHelper&) = delete;
+    DLLLOCAL LdapListHelper& operator=(const LdapListHelper&) = delete;
 };
 
-class QoreLDAPMod : public LDAPMod {
-protected:
-    DLLLOCAL int assignString(qore_size_t i, QoreValue p, const char* err, ExceptionSink* xsink) {
-        QoreStringValueHelper str(p, QCS_UTF8, xsink);
-        if (*xsink)
-            return -1;
-
-        if (mod_op != LDAP_MOD_DELETE && str->empty())
-            return missingValueError(err, xsink);
-
-        mod_values[i] = new char[str->size() + 1];
-        strcpy(mod_values[i], str->getBuffer());
+// sets the given berval to the given value; returns -1 if an exception was raised
+/** binary values are sent as-is, and all other values are sent as UTF-8 strings; binary values and UTF-8 strings
+    are referenced in place, so the value must remain valid as long as the berval is used, and only values that
+    need to be converted are copied to the arena
+*/
+DLLLOCAL static inline int q_ldap_set_berval(QoreLdapArena& arena, berval& bv, QoreValue v, ExceptionSink* xsink) {
+    switch (v.getType()) {
+        case NT_BINARY: {
+            const BinaryNode* b = v.get<const BinaryNode>();
+            bv.bv_val = (char*)b->getPtr();
+            bv.bv_len = b->size();
+            return 0;
+        }
 
-        //printd(5, "QoreLDAPMod::assignString() this: %p value[%zd]: '%s'\n", this, i, mod_values[i] ? mod_values[i] : "n/a");
-        return 0;
+        case NT_STRING: {
+            const QoreStringNode* str = v.get<const QoreStringNode>();
+            if (str->getEncoding() == QCS_UTF8) {
+                bv.bv_val = (char*)str->c_str();
+                bv.bv_len = str->size();
+                return 0;
+            }
+            break;
+        }
     }
 
-    DLLLOCAL int missingValueError(const char* err, ExceptionSink* xsink) const {
-        xsink->raiseException("LDAP-MODIFY-ERROR", "missing value for '%s' operation for attribute '%s'", mod_op == LDAP_MOD_ADD ? "add" : "replace", mod_type);
+    QoreStringValueHelper str(v, QCS_UTF8, xsink);
+    if (*xsink)
         return -1;
-    }
+    bv.bv_val = arena.copy(str->c_str(), str->size());
+    bv.bv_len = str->size();
+    return 0;
+}
 
+class BervalListHelper : public LdapListHelper<berval*> {
 public:
-    DLLLOCAL QoreLDAPMod(int n_mod_op, const char* attr, QoreValue p, const char* err, ExceptionSink* xsink) {
-        mod_op = n_mod_op;
-        mod_type = (char*)attr;
-        mod_values = 0;
-
-        qore_type_t t = p.getType();
-        if (t == NT_NOTHING) {
-            if (mod_op != LDAP_MOD_DELETE)
-                missingValueError(err, xsink);
+    DLLLOCAL BervalListHelper(const QoreListNode* strl, ExceptionSink* xsink) {
+        if (!strl || strl->empty())
             return;
-        }
 
-        if (t == NT_LIST) {
-            const QoreListNode* l = p.get<const QoreListNode>();
-            if (l->empty())
+        initList(strl->size());
+        berval* bv = arena.alloc<berval>(strl->size());
+        ConstListIterator li(strl);
+        while (li.next()) {
+            berval& e = bv[li.index()];
+            if (q_ldap_set_berval(arena, e, li.getValue(), xsink))
                 return;
-
-            mod_values = new char*[l->size() + 1];
-
-            ConstListIterator li(l);
-            while (li.next()) {
-                if (assignString(li.index(), li.getValue(), err, xsink)) {
-                    mod_values[li.index() + 1] = 0;
-                    return;
-                }
-            }
-        }
-        else {
-            mod_values = new char*[2];
-            assignString(0, p, err, xsink);
-            mod_values[1] = 0;
+            l[li.index()] = &e;
         }
     }
+};
 
-    DLLLOCAL ~QoreLDAPMod() {
-        if (mod_op & LDAP_MOD_BVALUES) {
-            if (mod_bvalues) {
-                for (berval** p = mod_bvalues; *p; ++p)
-                    delete [] *p;
-                delete [] mod_bvalues;
-            }
-        }
-        else {
-            if (mod_values) {
-                for (char** p = mod_values; *p; ++p)
-                    delete [] *p;
-                delete [] mod_values;
+class AttrListHelper : public LdapListHelper<char*> {
+public:
+    // UTF-8 strings are referenced in place; other values are converted to UTF-8 strings in the arena
+    DLLLOCAL AttrListHelper(const QoreListNode* attrl, ExceptionSink* xsink) {
+        if (!attrl || attrl->empty())
+            return;
+
+        initList(attrl->size());
+        ConstListIterator li(attrl);
+        while (li.next()) {
+            QoreValue v = li.getValue();
+            if (v.getType() == NT_STRING && v.get<const QoreStringNode>()->getEncoding() == QCS_UTF8) {
+                l[li.index()] = (char*)v.get<const QoreStringNode>()->c_str();
+                continue;
             }
+            QoreStringValueHelper str(v, QCS_UTF8, xsink);
+            if (*xsink)
+                return;
+            l[li.index()] = arena.copy(str->c_str(), str->size());
         }
     }
 };
 
-class ModListHelper : public LdapListHelper<QoreLDAPMod*> {
-protected:
-    bool op_add;
-
-    DLLLOCAL virtual int addElement(const ConstListIterator& li, ExceptionSink* xsink) {
-        QoreValue p = li.getValue();
-        if (p.getType() != NT_HASH) {
-            xsink->raiseException("LDAP-MODIFY-ERROR", "element %d/%d (starting from 0) is type '%s'; expecting 'hash'", li.index(), li.max(), p.getTypeName());
-            return -1;
-        }
-        const QoreHashNode* h = p.get<const QoreHashNode>();
-
-        const QoreStringNode* mod = check_hash_key<QoreStringNode>(xsink, *h, "mod", "LDAP-MODIFY-ERROR", "ldap modification hash");
-        if (!mod)
-            return -1;
-
-        int mod_op = modmap.get(mod->c_str());
-        if (mod_op == -1) {
-            xsink->raiseException("LDAP-MODIFY-ERROR", "element %d/%d (starting with 0) don't know how to process modification action '%s' (expecting one of 'add', 'delete', 'replace')", li.index(), li.max(), mod->c_str());
-            return -1;
-        }
-
-        const QoreStringNode* attr = check_hash_key<QoreStringNode>(xsink, *h, "attr", "LDAP-MODIFY-ERROR", "ldap modification hash");
-        if (!attr)
-            return -1;
-
-        p = h->getKeyValue("value");
-
-        std::unique_ptr<QoreLDAPMod> modp(new QoreLDAPMod(mod_op, attr->c_str(), p, "LDAP-MODIFY-ERROR", xsink));
-        if (*xsink)
-            return -1;
+// builds the modification array for add and modify requests
+/** values are always sent as bervals so that binary values and strings with embedded NUL characters are supported;
+    the modifications and value arrays are allocated in the arena and values are referenced in place where possible,
+    so the list or hash given must remain valid as long as the helper is used
+*/
+class ModListHelper : public LdapListHelper<LDAPMod*> {
+public:
+    DLLLOCAL ModListHelper(ExceptionSink* xsink, const QoreListNode* ql) {
+        if (!ql || ql->empty())
+            return;
 
-        l[li.index()] = modp.release();
-        return 0;
-    }
+        initList(ql->size());
+        LDAPMod* mods = arena.alloc<LDAPMod>(ql->size());
+        ConstListIterator li(ql);
+        while (li.next()) {
+            QoreValue p = li.getValue();
+            if (p.getType() != NT_HASH) {
+                xsink->raiseException("LDAP-MODIFY-ERROR", "element %d/%d (starting from 0) is type '%s'; expecting 'hash'", li.index(), li.max(), p.getTypeName());
+                return;
+            }
+            const QoreHashNode* h = p.get<const QoreHashNode>();
 
-    DLLLOCAL virtual int addElement(size_t index, const ConstHashIterator& hi, ExceptionSink* xsink) {
-        std::unique_ptr<QoreLDAPMod> mod(new QoreLDAPMod(LDAP_MOD_ADD, hi.getKey(), hi.get(), "LDAP-ADD-ERROR", xsink));
-        if (*xsink)
-            return -1;
+            const QoreStringNode* mod = check_hash_key<QoreStringNode>(xsink, *h, "mod", "LDAP-MODIFY-ERROR", "ldap modification hash");
+            if (!mod)
+                return;
 
-        l[index] = mod.release();
-        return 0;
-    }
+            int mod_op = modmap.get(mod->c_str());
+            if (mod_op == -1) {
+                xsink->raiseException("LDAP-MODIFY-ERROR", "element %d/%d (starting with 0) don't know how to process modification action '%s' (expecting one of 'add', 'delete', 'replace')", li.index(), li.max(), mod->c_str());
+                return;
+            }
 
-public:
-    DLLLOCAL ModListHelper(ExceptionSink* xsink, const QoreListNode* ql) : LdapListHelper<QoreLDAPMod*>(), op_add(false) {
-        init(ql, xsink);
+            const QoreStringNode* attr = check_hash_key<QoreStringNode>(xsink, *h, "attr", "LDAP-MODIFY-ERROR", "ldap modification hash");
+            if (!attr)
+                return;
 
-#if 0
-        printd(0, "ModListHelper::ModListHelper() this: %p len: %d\n", this, len);
-        for (unsigned i = 0; i < len; ++i) {
-            printd(0, "ModListHelper::ModListHelper() this: %p i: %d mod: %d attr: '%s'\n", this, i, l[i]->mod_op, l[i]->mod_type);
-            if (l[i]->mod_values) {
-                for (char** p = l[i]->mod_values; *p; ++p)
-                printd(0, "  + val: '%s'\n", *p);
-            }
+            LDAPMod& m = mods[li.index()];
+            if (initMod(m, mod_op, attr->c_str(), h->getKeyValue("value"), xsink))
+                return;
+            l[li.index()] = &m;
         }
-#endif
     }
 
-    DLLLOCAL ModListHelper(ExceptionSink* xsink, const QoreHashNode* attr) : LdapListHelper<QoreLDAPMod*>(), op_add(true) {
-        // convert list to attribute list
+    DLLLOCAL ModListHelper(ExceptionSink* xsink, const QoreHashNode* attr) {
         if (!attr || attr->empty())
             return;
 
-        len = attr->size();
-
-        l = new QoreLDAPMod*[attr->size() + 1];
+        initList(attr->size());
+        LDAPMod* mods = arena.alloc<LDAPMod>(attr->size());
         ConstHashIterator hi(attr);
         size_t index = 0;
         while (hi.next()) {
-            if (addElement(index, hi, xsink)) {
-                len = index;
+            LDAPMod& m = mods[index];
+            if (initMod(m, LDAP_MOD_ADD, hi.getKey(), hi.get(), xsink))
                 return;
+            l[index++] = &m;
+        }
+    }
+
+protected:
+    DLLLOCAL int initMod(LDAPMod& m, int mod_op, const char* attr, QoreValue p, ExceptionSink* xsink) {
+        m.mod_op = mod_op | LDAP_MOD_BVALUES;
+        m.mod_type = (char*)attr;
+        m.mod_bvalues = nullptr;
+
+        qore_type_t t = p.getType();
+        if (t == NT_NOTHING) {
+            if (mod_op != LDAP_MOD_DELETE)
+                return missingValueError(m, xsink);
+            return 0;
+        }
+
+        if (t == NT_LIST) {
+            const QoreListNode* vl = p.get<const QoreListNode>();
+            if (vl->empty())
+                return 0;
+
+            allocValues(m, vl->size());
+            ConstListIterator li(vl);
+            while (li.next()) {
+                if (assignValue(m, li.index(), li.getValue(), xsink))
+                    return -1;
             }
-            ++index;
+            return 0;
         }
-        // terminate list with a 0
-        l[index] = 0;
-        return;
+
+        allocValues(m, 1);
+        return assignValue(m, 0, p, xsink);
     }
 
-    DLLLOCAL virtual ~ModListHelper() {
-        if (!l)
-            return;
+    // allocates the value array and the bervals for the given number of values; the array is 0-terminated
+    DLLLOCAL void allocValues(LDAPMod& m, size_t n) {
+        m.mod_bvalues = arena.alloc<berval*>(n + 1);
+        berval* bv = arena.alloc<berval>(n);
+        for (size_t i = 0; i < n; ++i)
+            m.mod_bvalues[i] = &bv[i];
+        m.mod_bvalues[n] = nullptr;
+    }
+
+    DLLLOCAL int assignValue(LDAPMod& m, size_t i, QoreValue p, ExceptionSink* xsink) {
+        berval& bv = *m.mod_bvalues[i];
+        if (q_ldap_set_berval(arena, bv, p, xsink))
+            return -1;
+
+        if ((m.mod_op & ~LDAP_MOD_BVALUES) != LDAP_MOD_DELETE && !bv.bv_len)
+            return missingValueError(m, xsink);
+
+        return 0;
+    }
 
-        for (unsigned i = 0; i < len; ++i)
-            delete l[i];
-        delete [] l;
+    DLLLOCAL static int missingValueError(const LDAPMod& m, ExceptionSink* xsink) {
+        xsink->raiseException("LDAP-MODIFY-ERROR", "missing value for '%s' operation for attribute '%s'", (m.mod_op & ~LDAP_MOD_BVALUES) == LDAP_MOD_ADD ? "add" : "replace", m.mod_type);
+        return -1;
     }
 };
 
@@ -443,596 +419,4557 @@ public:
     }
 };
 
-class QoreLdapClient;
+// LDAP operation types
+enum qore_ldap_op_e : unsigned char {
+    QLO_SEARCH = 0,
+    QLO_ADD,
+    QLO_MODIFY,
+    QLO_DELETE,
+    QLO_COMPARE,
+    QLO_RENAME,
+    QLO_PASSWD,
+};
 
-class QoreLdapParseResultHelper {
-protected:
-    const char* meth;
-    const char* f;
-    QoreLdapClient* l;
-    ExceptionSink* xsink;
-    int err;
-    char* matched;
-    char* text;
-    char** refs;
+static_assert((int)QLS_PASSWD == (int)QLO_PASSWD, "statistics operation types must match qore_ldap_op_e");
+
+// default number of times idempotent operations are retried after reconnecting
+#define QORE_LDAP_DEFAULT_MAX_RETRIES 3
+// default initial delay before reconnecting in milliseconds; doubled for each retry
+#define QORE_LDAP_DEFAULT_RETRY_DELAY_MS 100
+
+// search result formats
+enum qore_ldap_format_e : unsigned char {
+    // a hash keyed by DN
+    QLF_HASH = 0,
+    // a list of hashes with "dn" and "attributes" keys
+    QLF_LIST = 1,
+    // a hash of lists aligned by entry index
+    QLF_COLUMNAR = 2,
+};
 
-public:
-    DLLLOCAL QoreLdapParseResultHelper(const char *n_meth, const char* n_f, QoreLdapClient* n_l, LDAPMessage* msg, ExceptionSink* xs);
+// attribute value types derived from the server's schema
+enum qore_ldap_value_type_e : unsigned char {
+    QLT_STRING = 0,
+    QLT_INT,
+    QLT_DATE,
+    QLT_BOOL,
+};
 
-    DLLLOCAL ~QoreLdapParseResultHelper() {
-        if (matched)
-            ldap_memfree(matched);
-        if (text)
-            ldap_memfree(text);
-        if (refs)
-            ldap_memvfree((void**)refs);
+// map of lower-case attribute names to value types; only attributes with non-string types are present
+typedef std::map<std::string, qore_ldap_value_type_e> ldap_schema_type_map_t;
+
+// options for decoding search results
+struct QoreLdapResultOpts {
+    qore_ldap_format_e format = QLF_HASH;
+    // lower-case names of attributes whose values are returned as binary values
+    std::set<std::string> binary;
+    // attribute value types from the server's schema if typed values are requested
+    std::shared_ptr<const ldap_schema_type_map_t> types;
+    // set if typed values are requested
+    bool typed = false;
+
+    // returns the lower-case attribute name without attribute options
+    DLLLOCAL static std::string getKey(const char* attr) {
+        const char* p = strchr(attr, ';');
+        std::string key(attr, p ? (size_t)(p - attr) : strlen(attr));
+        for (auto& c : key)
+            c = tolower((unsigned char)c);
+        return key;
     }
 
-    DLLLOCAL int getError() const {
-        return err;
+    // returns true if values of the given attribute are returned as binary values
+    /** attributes with the "binary" attribute option are always returned as binary values
+    */
+    DLLLOCAL bool isBinary(const char* attr) const {
+        if (strcasestr(attr, ";binary"))
+            return true;
+        return !binary.empty() && binary.find(getKey(attr)) != binary.end();
     }
 
-    DLLLOCAL int check() const;
+    // returns the value type for the given attribute
+    DLLLOCAL qore_ldap_value_type_e getType(const char* attr) const {
+        if (!types || types->empty())
+            return QLT_STRING;
+        ldap_schema_type_map_t::const_iterator i = types->find(getKey(attr));
+        return i == types->end() ? QLT_STRING : i->second;
+    }
 };
 
-// the c++ object
-class QoreLdapClient : public AbstractPrivateData {
-    friend class QoreLdapParseResultHelper;
-
-protected:
-    // ldap context
-    LDAP* ldp;
-    // mutual-exclusion lock
-    mutable QoreThreadLock m;
-    // saved URI
-    QoreStringNode* uri;
-    // saved bind parameters
-    QoreHashNode* bh;
-    // ldap protocol version
-    int prot;
-    // ldap default timeout in ms
-    int timeout_ms;
-    // boolean flags
-    bool tls : 1,        // issue a STARTTLS command if the session is not already secure
-        no_referrals : 1; // do not follow referrals
+// the maximum size in bytes of attribute values that are shared between the entries of a search result
+#define QORE_LDAP_INTERN_MAX_LEN 64
+// the maximum number of distinct values shared between the entries of a search result
+#define QORE_LDAP_INTERN_MAX_VALUES 4096
+// the number of values of an attribute after which its values are only shared if at least half were repeated
+#define QORE_LDAP_INTERN_SAMPLE 64
+
+// strings shared between the entries of a single search result
+/** the value options for each attribute name are determined once instead of for each entry, and short string
+    values that repeat across entries (such as \c objectClass values) are returned as references to a single
+    string; attributes whose values are mostly unique stop being interned after a sample of values
+*/
+class QoreLdapInternTable {
+public:
+    // the value options and interning statistics for an attribute name as returned by the server
+    struct AttrInfo {
+        bool bin = false;
+        qore_ldap_value_type_e type = QLT_STRING;
+        // the number of values looked up in the table and the number found
+        unsigned lookups = 0;
+        unsigned hits = 0;
+    };
+
+    DLLLOCAL QoreLdapInternTable() {
+    }
 
-    QoreStringNode* getErrorText(const char* meth, const char* f, int ec) const {
-        QoreStringNode* desc = new QoreStringNode("ldap server ");
-        if (uri)
-            desc->sprintf("'%s' ", uri->getBuffer());
-        desc->sprintf("returned error code %d", ec);
-        desc->sprintf(" when calling %s() in LdapClient::%s(): %s", f, meth, ldap_err2string(ec));
-        return desc;
+    DLLLOCAL ~QoreLdapInternTable() {
+        for (auto& i : values)
+            i.second->deref();
     }
 
-    void doLdapError(const char* meth, const char* f, int ec, ExceptionSink* xsink) const {
-        xsink->raiseException("LDAP-ERROR", getErrorText(meth, f, ec));
+    // returns the value options for the given attribute
+    DLLLOCAL AttrInfo& getAttr(const char* attr, const QoreLdapResultOpts* ropts) {
+        attr_map_t::iterator i = attrs.find(attr);
+        if (i != attrs.end())
+            return i->second;
+
+        AttrInfo ai;
+        if (ropts) {
+            ai.bin = ropts->isBinary(attr);
+            if (!ai.bin)
+                ai.type = ropts->getType(attr);
+        }
+        return attrs.insert(attr_map_t::value_type(attr, ai)).first->second;
     }
 
-    int checkLdapError(const char* meth, const char* f, int ec, ExceptionSink* xsink) const {
-        //printd(5, "QoreLdapClient::checkLdapError() %s() rc: %d\n", f, ec);
-        if (ec == LDAP_SUCCESS)
-            return 0;
-        doLdapError(meth, f, ec, xsink);
-        return -1;
+    // returns a string for the given value, shared with earlier equal values of any attribute where possible
+    DLLLOCAL QoreStringNode* getString(AttrInfo& ai, const berval* bv) {
+        if (bv->bv_len > QORE_LDAP_INTERN_MAX_LEN
+            || (ai.lookups >= QORE_LDAP_INTERN_SAMPLE && ai.hits * 2 < ai.lookups)) {
+            return new QoreStringNode(bv->bv_val, bv->bv_len, QCS_UTF8);
+        }
+
+        ++ai.lookups;
+        std::string key(bv->bv_val, bv->bv_len);
+        value_map_t::iterator i = values.find(key);
+        if (i != values.end()) {
+            ++ai.hits;
+            return i->second->stringRefSelf();
+        }
+
+        QoreStringNode* str = new QoreStringNode(bv->bv_val, bv->bv_len, QCS_UTF8);
+        if (values.size() < QORE_LDAP_INTERN_MAX_VALUES)
+            values.insert(value_map_t::value_type(std::move(key), str->stringRefSelf()));
+        return str;
     }
 
-    DLLLOCAL int checkFreeResult(const char* meth, const char* f, LDAPMessage* res, ExceptionSink* xsink) {
-        QoreLdapParseResultHelper prh(meth, f, this, res, xsink);
-        if (*xsink)
-            return -1;
-        return prh.check();
+private:
+    typedef std::unordered_map<std::string, AttrInfo> attr_map_t;
+    typedef std::unordered_map<std::string, QoreStringNode*> value_map_t;
+
+    attr_map_t attrs;
+    value_map_t values;
+
+    DLLLOCAL QoreLdapInternTable(const QoreLdapInternTable&) = delete;
+    DLLLOCAL QoreLdapInternTable& operator=(const QoreLdapInternTable&) = delete;
+};
+
+// an operation waiting for responses in multiplexed mode or started with an asynchronous method
+struct QoreLdapPendingOp {
+    // the method and function names for error messages
+    const char* meth;
+    const char* f;
+    // the operation type
+    qore_ldap_op_e type;
+    // set if the operation's responses are retrieved with LdapClient::wait() and related methods
+    bool async;
+    // messages received for the operation and not yet retrieved
+    std::deque<LDAPMessage*> msgs;
+    // the error code if the session failed while the operation was pending
+    int err = LDAP_SUCCESS;
+    // set when the final response has been received or the session failed
+    bool done = false;
+    // set while a thread is waiting for the operation with LdapClient::wait() or LdapClient::waitAny(); a claimed
+    // operation cannot be retrieved or abandoned by another thread
+    bool claimed = false;
+    // result options for asynchronous search operations
+    QoreLdapResultOpts ropts;
+    // the requested attributes of asynchronous searches with columnar results
+    std::vector<std::string> attrs;
+    // DNs to invalidate in the search cache when a write operation completes
+    std::vector<std::string> inval;
+    // the time the request was sent in microseconds for statistics
+    int64 sent;
+    // the number of entries retrieved one at a time for statistics
+    int64 entries = 0;
+
+    DLLLOCAL QoreLdapPendingOp(const char* meth, const char* f, qore_ldap_op_e type, bool async) : meth(meth), f(f), type(type), async(async), sent(q_clock_getmicros()) {
     }
 
-    int checkLdapResult(const char* meth, const char* f, int ec, ExceptionSink* xsink) const {
-        //printd(5, "QoreLdapClient::checkLdapResult() rc: %d\n", ec);
-        // timeout
-        if (!ec) {
-            doLdapError(meth, f, LDAP_TIMEOUT, xsink);
-            return -1;
-        }
-        if (ec == -1) {
-            doLdapError(meth, f, ec, xsink);
-            return -1;
-        }
-        return 0;
+    DLLLOCAL ~QoreLdapPendingOp() {
+        for (auto& i : msgs)
+            ldap_msgfree(i);
     }
+};
 
-    DLLLOCAL int checkValidIntern(const char* m, ExceptionSink* xsink) const {
-        if (!ldp) {
-            xsink->raiseException("LDAP-NO-CONTEXT", "cannot execute LdapClient::%s(); the LdapClient object has been destroyed or the session context has been unbound", m);
-            return -1;
-        }
+// map of message IDs to pending operations
+typedef std::map<int, QoreLdapPendingOp*> ldap_pending_map_t;
 
-        return 0;
+// map of handles to asynchronous operations that failed when the session context was reinitialized
+typedef std::map<int64, QoreLdapPendingOp*> ldap_orphan_map_t;
+
+// list of result messages for a single operation; frees the messages when it goes out of scope
+class QoreLdapMessageList : public std::vector<LDAPMessage*> {
+public:
+    DLLLOCAL QoreLdapMessageList() {
+    }
+
+    DLLLOCAL ~QoreLdapMessageList() {
+        for (auto& i : *this)
+            ldap_msgfree(i);
     }
 
-    DLLLOCAL int unbindIntern(ExceptionSink* xsink, int my_timeout_ms = 0) {
-        ldap_unbind_ext_s(ldp, 0, 0);
-        ldp = 0;
+private:
+    DLLLOCAL QoreLdapMessageList(const QoreLdapMessageList&) = delete;
+    DLLLOCAL QoreLdapMessageList& operator=(const QoreLdapMessageList&) = delete;
+};
+
+DLLLOCAL extern qore_classid_t CID_LDAPCLIENT;
+DLLLOCAL extern QoreClass* QC_LDAPCLIENT;
+
+// search parameters parsed from a search hash
+struct QoreLdapSearchParams {
+    const QoreStringNode* base = nullptr;
+    const QoreStringNode* filter = nullptr;
+    ReferenceHolder<QoreListNode> attrl;
+    int scope = LDAP_SCOPE_SUBTREE;
+    // the page size for the simple paged results control; 0 = no paging
+    int page_size = 0;
+    QoreLdapResultOpts ropts;
+    bool attrsonly = false;
+    // set if the search cache can be used
+    bool use_cache = true;
+    // the sort key list for the server-side sort control (RFC 2891) and its string form; 0 = no sorting
+    LDAPSortKey** sort_keys = nullptr;
+    std::string sort;
+    // set if the virtual list view control is used
+    bool vlv = false;
+    // set if the target entry of the virtual list view is given by an assertion value instead of an offset
+    bool vlv_by_value = false;
+    // set if a context ID from a previous virtual list view response is sent
+    bool vlv_has_context = false;
+    // the number of entries before and after the target entry
+    int vlv_before = 0;
+    int vlv_after = 0;
+    // the 1-based offset of the target entry and the client's estimate of the number of entries
+    int vlv_offset = 1;
+    int vlv_count = 0;
+    // the assertion value and context ID
+    std::string vlv_value;
+    std::string vlv_context;
+    ExceptionSink* xsink;
 
-        return initIntern(xsink, "bind", my_timeout_ms);
+    DLLLOCAL QoreLdapSearchParams(ExceptionSink* xsink) : attrl(xsink), xsink(xsink) {
     }
 
-    DLLLOCAL int initIntern(ExceptionSink* xsink, const char* m, const QoreStringNode& uristr) {
-        assert(!ldp);
-        assert(!uri);
-        uri = uristr.stringRefSelf();
-        return initIntern(xsink, m);
+    DLLLOCAL ~QoreLdapSearchParams() {
+        if (sort_keys)
+            ldap_free_sort_keylist(sort_keys);
     }
 
-    DLLLOCAL int initIntern(ExceptionSink* xsink, const char* m, int my_timeout_ms = 0) {
-        if (checkLdapError(m, "ldap_initialize", ldap_initialize(&ldp, uri->getBuffer()), xsink))
+    // returns -1 if an exception was raised
+    DLLLOCAL int parse(const QoreHashNode& h) {
+        base = check_hash_key<QoreStringNode>(xsink, h, "base", "LDAP-SEARCH-ERROR");
+        filter = check_hash_key<QoreStringNode>(xsink, h, "filter", "LDAP-SEARCH-ERROR");
+        QoreValue n = h.getKeyValue("attributes");
+        if (n) {
+            if (n.getType() == NT_STRING) {
+                attrl = new QoreListNode(autoTypeInfo);
+                attrl->push(n.refSelf(), xsink);
+            }
+            else if (n.getType() == NT_LIST)
+                attrl = n.get<const QoreListNode>()->listRefSelf();
+            else {
+                xsink->raiseException("LDAPCLIENT-SEARCH-ERROR", "the 'attributes' key of the search hash contains type '%s' (expecting 'list' or 'string')", n.getTypeName());
+                return -1;
+            }
+        }
+        if (*xsink)
             return -1;
 
-        // set protocol version
-        if (ldap_set_option(ldp, LDAP_OPT_PROTOCOL_VERSION, &prot)) {
-            xsink->raiseException("LDAP-ERROR", "failed to set LDAP protocol v%d; ldap_set_option(LDAP_OPT_PROTOCOL_VERSION) failed", prot);
-            return -1;
-        }
+        // get scope
+        n = h.getKeyValue("scope");
+        int i = n.getAsBigInt();
+        if (i)
+            scope = i;
 
-        // set restart option
-        if (ldap_set_option(ldp, LDAP_OPT_RESTART, LDAP_OPT_ON)) {
-            xsink->raiseException("LDAP-ERROR", "failed to set LDAP restart option; ldap_set_option(LDAP_OPT_RESTART) failed");
+        n = h.getKeyValue("page_size");
+        int64 ps = n.getAsBigInt();
+        if (ps < 0) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "invalid 'page_size' value " QLLD "; expecting a value >= 0", ps);
             return -1;
         }
+        page_size = (int)ps;
 
-        // set timeout
-        TimeoutHelper timeout(timeout_ms);
-
-        if (ldap_set_option(ldp, LDAP_OPT_TIMEOUT, &timeout)) {
-            xsink->raiseException("LDAP-ERROR", "failed to set default LDAP timeout to %d ms; ldap_set_option(LDAP_OPT_TIMEOUT) failed", timeout_ms);
+        const QoreStringNode* fmt = check_hash_key<QoreStringNode>(xsink, h, "format", "LDAP-SEARCH-ERROR");
+        if (*xsink)
             return -1;
+        if (fmt) {
+            if (*fmt == "hash")
+                ropts.format = QLF_HASH;
+            else if (*fmt == "list")
+                ropts.format = QLF_LIST;
+            else if (*fmt == "columnar")
+                ropts.format = QLF_COLUMNAR;
+            else {
+                xsink->raiseException("LDAP-SEARCH-ERROR", "invalid 'format' value '%s'; expecting one of 'hash', 'list', or 'columnar'", fmt->c_str());
+                return -1;
+            }
         }
 
-        // disable referrals if necessary
-        if (no_referrals && ldap_set_option(ldp, LDAP_OPT_REFERRALS, LDAP_OPT_OFF)) {
-            xsink->raiseException("LDAP-ERROR", "failed to disable LDAP referrals; ldap_set_option(LDAP_OPT_REFERRALS) failed");
+        n = h.getKeyValue("binary_attributes");
+        if (n.getType() == NT_STRING)
+            ropts.binary.insert(QoreLdapResultOpts::getKey(n.get<const QoreStringNode>()->c_str()));
+        else if (n.getType() == NT_LIST) {
+            ConstListIterator li(n.get<const QoreListNode>());
+            while (li.next()) {
+                QoreStringValueHelper str(li.getValue());
+                ropts.binary.insert(QoreLdapResultOpts::getKey(str->c_str()));
+            }
+        }
+        else if (!n.isNothing()) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the 'binary_attributes' key of the search hash contains type '%s' (expecting 'list' or 'string')", n.getTypeName());
             return -1;
         }
 
-        if (my_timeout_ms && my_timeout_ms != timeout_ms)
-            timeout = my_timeout_ms;
+        ropts.typed = h.getKeyValue("typed_values").getAsBool();
 
-        // force a connection to the server with an empty search request and ignore the result
-        int msgid;
-        if (checkLdapError(m, "ldap_search_ext", ldap_search_ext(ldp, 0, LDAP_SCOPE_BASE, 0, 0, 0, 0, 0, 0, 0, &msgid), xsink))
+        n = h.getKeyValue("cache");
+        if (!n.isNothing())
+            use_cache = n.getAsBool();
+
+        return parseSort(h) || parseVlv(h) ? -1 : 0;
+    }
+
+    // parses the "sort" option; returns -1 if an exception was raised
+    /** sort keys have the format <tt>[-]attribute[:matchingRule]</tt>, where a leading \c "-" sorts in reverse
+        order
+    */
+    DLLLOCAL int parseSort(const QoreHashNode& h) {
+        QoreValue n = h.getKeyValue("sort");
+        if (n.isNothing())
+            return 0;
+        if (n.getType() == NT_STRING) {
+            QoreStringValueHelper str(n, QCS_UTF8, xsink);
+            if (*xsink)
+                return -1;
+            sort = str->c_str();
+        } else if (n.getType() == NT_LIST) {
+            ConstListIterator li(n.get<const QoreListNode>());
+            while (li.next()) {
+                QoreStringValueHelper str(li.getValue(), QCS_UTF8, xsink);
+                if (*xsink)
+                    return -1;
+                if (!sort.empty())
+                    sort += ' ';
+                sort += str->c_str();
+            }
+        } else {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the 'sort' key of the search hash contains type '%s' (expecting 'list' or 'string')", n.getTypeName());
             return -1;
-        LDAPMessage* res = 0;
-        if (checkLdapResult(m, "ldap_search_ext", ldap_result(ldp, msgid, LDAP_MSG_ALL, &timeout, &res), xsink)) {
-            assert(!res);
+        }
+
+        if (sort.empty() || ldap_create_sort_keylist(&sort_keys, (char*)sort.c_str()) != LDAP_SUCCESS) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "invalid 'sort' value '%s'; expecting sort keys in the format \"[-]attribute[:matchingRule]\"", sort.c_str());
             return -1;
         }
-        ldap_msgfree(res);
+        return 0;
+    }
 
-        // issue a STARTTLS if necessary
-        if (tls && !ldap_tls_inplace(ldp)) {
-            if (checkLdapError("constructor", "ldap_start_tls_s", ldap_start_tls_s(ldp, 0, 0), xsink))
+    // parses the "vlv" option; returns -1 if an exception was raised
+    DLLLOCAL int parseVlv(const QoreHashNode& h) {
+        QoreValue n = h.getKeyValue("vlv");
+        if (n.isNothing())
+            return 0;
+        if (n.getType() != NT_HASH) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the 'vlv' key of the search hash contains type '%s' (expecting 'hash')", n.getTypeName());
+            return -1;
+        }
+        if (!sort_keys) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the 'vlv' option requires the 'sort' option to be set");
+            return -1;
+        }
+        if (page_size) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the 'vlv' and 'page_size' options cannot be used together");
+            return -1;
+        }
+        const QoreHashNode* vh = n.get<const QoreHashNode>();
+
+        if (getVlvInt(*vh, "before_count", 0, vlv_before) || getVlvInt(*vh, "after_count", 0, vlv_after)
+            || getVlvInt(*vh, "offset", 1, vlv_offset) || getVlvInt(*vh, "content_count", 0, vlv_count)) {
+            return -1;
+        }
+
+        QoreValue v = vh->getKeyValue("value");
+        if (!v.isNothing()) {
+            if (!vh->getKeyValue("offset").isNothing()) {
+                xsink->raiseException("LDAP-SEARCH-ERROR", "the 'offset' and 'value' keys of the 'vlv' option cannot be used together");
                 return -1;
-            //printd(0, "QoreLdapClient::initIntern() STARTTLS successful\n");
+            }
+            if (getVlvBytes(v, vlv_value))
+                return -1;
+            vlv_by_value = true;
+        }
+
+        v = vh->getKeyValue("context");
+        if (!v.isNothing()) {
+            if (getVlvBytes(v, vlv_context))
+                return -1;
+            vlv_has_context = true;
         }
 
+        vlv = true;
+        // the window depends on the position of entries in the complete result
+        use_cache = false;
         return 0;
     }
 
-    DLLLOCAL int bindInitIntern(ExceptionSink* xsink, const char* m, const QoreHashNode& bindh, int my_timeout_ms = 0) {
-        assert(ldp);
-
-        const QoreStringNode* password = check_hash_key<QoreStringNode>(xsink, bindh, "password", "LDAP-BIND-ERROR");
-
-        const QoreStringNode* binddn = check_hash_key<QoreStringNode>(xsink, bindh, "binddn", "LDAP-BIND-ERROR");
-        if (!binddn) {
-            if (password && !password->empty())
-                xsink->raiseException("LDAP-BIND-ERROR", "password given but no bind DN given for bind");
+    // gets a non-negative integer value of the "vlv" option; returns -1 if an exception was raised
+    DLLLOCAL int getVlvInt(const QoreHashNode& vh, const char* key, int def, int& val) {
+        QoreValue v = vh.getKeyValue(key);
+        if (v.isNothing()) {
+            val = def;
+            return 0;
+        }
+        int64 i = v.getAsBigInt();
+        if (i < 0 || i > INT_MAX) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "invalid '%s' value " QLLD " in the 'vlv' option; expecting a value >= 0", key, i);
             return -1;
         }
+        val = (int)i;
+        return 0;
+    }
 
-        QoreStringValueHelper bstr(binddn, QCS_UTF8, xsink);
+    // gets a binary or string value of the "vlv" option as bytes; returns -1 if an exception was raised
+    DLLLOCAL int getVlvBytes(QoreValue v, std::string& val) {
+        if (v.getType() == NT_BINARY) {
+            const BinaryNode* b = v.get<const BinaryNode>();
+            val.assign((const char*)b->getPtr(), b->size());
+            return 0;
+        }
+        QoreStringValueHelper str(v, QCS_UTF8, xsink);
         if (*xsink)
             return -1;
+        val.assign(str->c_str(), str->size());
+        return 0;
+    }
 
-        QoreStringBervalHelper passwd(password, xsink);
-        if (*xsink)
-            return -1;
+    // returns the search cache key for the search; all parameters affecting the result are included
+    DLLLOCAL std::string getCacheKey() const {
+        std::string key;
+        auto add = [&key] (const char* str) {
+            key += str;
+            key += '\0';
+        };
+        add(base ? base->c_str() : "");
+        add(filter ? filter->c_str() : "");
+        key += (char)('0' + scope);
+        key += attrsonly ? '1' : '0';
+        key += (char)('0' + ropts.format);
+        key += ropts.typed ? '1' : '0';
+        key += '\0';
+        add(sort.c_str());
+        if (attrl) {
+            ConstListIterator li(*attrl);
+            while (li.next()) {
+                QoreStringValueHelper str(li.getValue());
+                add(str->c_str());
+            }
+        }
+        key += '\0';
+        for (auto& i : ropts.binary)
+            add(i.c_str());
+        return key;
+    }
+};
 
-        int msgid;
+// builds a search result in the requested format
+class QoreLdapSearchResult {
+public:
+    DLLLOCAL QoreLdapSearchResult(const QoreLdapResultOpts& ropts, const QoreListNode* attrl, ExceptionSink* xsink) : ropts(ropts), format(ropts.format), xsink(xsink), h(format == QLF_LIST ? nullptr : new QoreHashNode, xsink), l(format == QLF_LIST ? new QoreListNode(autoTypeInfo) : nullptr, xsink) {
+        if (format != QLF_COLUMNAR)
+            return;
 
-        if (checkLdapError(m, "ldap_sasl_bind", ldap_sasl_bind(ldp, bstr->getBuffer(), LDAP_SASL_SIMPLE, &passwd, 0, 0, &msgid), xsink))
-            return -1;
+        dnl = new QoreListNode(autoTypeInfo);
+        h->setKeyValue("dn", dnl, xsink);
+        attrs = new QoreHashNode;
+        h->setKeyValue("attributes", attrs, xsink);
 
-        LDAPMessage* result = 0;
-        TimeoutHelper timeout(my_timeout_ms);
+        // create columns for the requested attributes unless all attributes were requested
+        if (!attrl)
+            return;
+        ConstListIterator li(attrl);
+        while (li.next()) {
+            QoreValue v = li.getValue();
+            if (v.getType() != NT_STRING)
+                continue;
+            const QoreStringNode* str = v.get<const QoreStringNode>();
+            if (*str == "*" || *str == "+") {
+                fixed = false;
+                return;
+            }
+            std::string key = getKey(str->c_str());
+            if (cols.find(key) != cols.end())
+                continue;
+            QoreListNode* col = new QoreListNode(autoTypeInfo);
+            attrs->setKeyValue(str->c_str(), col, xsink);
+            cols[key] = col;
+            fixed = true;
+        }
+    }
 
-        if (checkLdapResult(m, "ldap_sasl_bind", ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &result), xsink)) {
-            assert(!result);
-            return -1;
+    DLLLOCAL qore_ldap_format_e getFormat() const {
+        return format;
+    }
+
+    DLLLOCAL const QoreLdapResultOpts& getOpts() const {
+        return ropts;
+    }
+
+    DLLLOCAL QoreLdapInternTable& getInternTable() {
+        return intern;
+    }
+
+    // adds an entry in hash format
+    DLLLOCAL void addHash(const char* dn, QoreHashNode* he) {
+        h->setKeyValue(dn, he, xsink);
+    }
+
+    // adds an entry in list format
+    DLLLOCAL void addList(QoreHashNode* entry) {
+        l->push(entry, xsink);
+    }
+
+    // starts an entry in columnar format
+    DLLLOCAL void beginColumnarEntry(const berval& dn) {
+        dnl->push(new QoreStringNode(dn.bv_val, dn.bv_len, QCS_UTF8), xsink);
+        ++count;
+    }
+
+    // adds an attribute value to the current entry in columnar format
+    DLLLOCAL void addColumnarValue(const char* attr, QoreValue v) {
+        std::string key = getKey(attr);
+        col_map_t::iterator i = cols.find(key);
+        if (i == cols.end()) {
+            // discard attributes that were not requested
+            if (fixed) {
+                v.discard(xsink);
+                return;
+            }
+            // pad the new column for all previous entries
+            QoreListNode* col = new QoreListNode(autoTypeInfo);
+            for (size_t j = 1; j < count; ++j)
+                col->push(QoreValue(), xsink);
+            attrs->setKeyValue(attr, col, xsink);
+            i = cols.insert(col_map_t::value_type(key, col)).first;
+        }
+        i->second->push(v, xsink);
+    }
+
+    // ends the current entry in columnar format by padding columns without a value for the entry
+    DLLLOCAL void endColumnarEntry() {
+        for (auto& i : cols) {
+            if (i.second->size() < count)
+                i.second->push(QoreValue(), xsink);
+        }
+    }
+
+    // returns the number of entries in the result
+    DLLLOCAL size_t size() const {
+        switch (format) {
+            case QLF_LIST: return l->size();
+            case QLF_COLUMNAR: return count;
+            default: return h->size();
+        }
+    }
+
+    DLLLOCAL QoreValue release() {
+        if (format == QLF_LIST)
+            return l.release();
+        return h.release();
+    }
+
+    // the size of the DNs and attribute values of the entries added in bytes
+    size_t bytes = 0;
+
+protected:
+    // map of lower-case attribute names to columns
+    typedef std::map<std::string, QoreListNode*> col_map_t;
+
+    const QoreLdapResultOpts& ropts;
+    qore_ldap_format_e format;
+    ExceptionSink* xsink;
+    ReferenceHolder<QoreHashNode> h;
+    ReferenceHolder<QoreListNode> l;
+    // the DN column and the attribute hash for the columnar format
+    QoreListNode* dnl = nullptr;
+    QoreHashNode* attrs = nullptr;
+    col_map_t cols;
+    // the number of entries added in columnar format
+    size_t count = 0;
+    // set if only columns for the requested attributes are returned
+    bool fixed = false;
+    // strings shared between the entries added
+    QoreLdapInternTable intern;
+
+    // attribute names are case-insensitive
+    DLLLOCAL static std::string getKey(const char* attr) {
+        std::string key(attr);
+        for (auto& c : key)
+            c = tolower((unsigned char)c);
+        return key;
+    }
+};
+
+// a paged results cookie returned by the server
+struct QoreLdapPageCookie : public berval {
+    DLLLOCAL QoreLdapPageCookie() {
+        bv_val = 0;
+        bv_len = 0;
+    }
+
+    DLLLOCAL ~QoreLdapPageCookie() {
+        clear();
+    }
+
+    DLLLOCAL void clear() {
+        if (bv_val) {
+            ldap_memfree(bv_val);
+            bv_val = 0;
         }
+        bv_len = 0;
+    }
 
-        return checkFreeResult(m, "ldap_sasl_bind", result, xsink);
+    // returns true if there are more pages to retrieve
+    DLLLOCAL operator bool() const {
+        return bv_val && bv_len;
     }
+};
 
+// the maximum number of server controls sent with a single request
+#define QORE_LDAP_MAX_REQUEST_CTRLS 4
+
+// a NULL-terminated list of server controls for a single request; frees the controls created for the request when
+// it goes out of scope
+class QoreLdapControlList {
 public:
-    DLLLOCAL QoreLdapClient(const QoreStringNode* uristr, const QoreHashNode* opth, ExceptionSink* xsink) : ldp(0), uri(0), bh(0), prot(QORE_LDAP_DEFAULT_PROTOCOL), timeout_ms(QORE_LDAP_DEFAULT_TIMEOUT_MS), tls(false), no_referrals(false) {
-        //printd(5, "QoreLdapClient::QoreLdapClient() this: %p uri: '%s' opth: %p\n", this, uristr->getBuffer(), opth);
+    DLLLOCAL QoreLdapControlList() {
+    }
 
-        if (opth) {
-            QoreValue p = opth->getKeyValue("protocol");
-            int i = p.getAsBigInt();
-            if (i)
-                prot = i;
+    DLLLOCAL ~QoreLdapControlList() {
+        for (int i = 0; i < n; ++i) {
+            if (owned[i])
+                ldap_control_free(ctrls[i]);
+        }
+    }
 
-            i = getMsZeroInt(opth->getKeyValue("timeout"));
-            if (i)
-                timeout_ms = i;
+    // adds the given control; if \a own is true, then the control is freed when the list goes out of scope
+    DLLLOCAL void add(LDAPControl* ctrl, bool own = true) {
+        assert(n < QORE_LDAP_MAX_REQUEST_CTRLS);
+        ctrls[n] = ctrl;
+        owned[n++] = own;
+    }
 
-            //printd(0, "QoreLdapClient::QoreLdapClient() set default timeout to %d ms\n", timeout_ms);
+    // returns the list of controls or 0 if there are none
+    DLLLOCAL LDAPControl** get() {
+        return n ? ctrls : nullptr;
+    }
 
-            p = opth->getKeyValue("no-referrals");
-            bool refp = p.getAsBool();
-            if (refp)
-                no_referrals = true;
+private:
+    LDAPControl* ctrls[QORE_LDAP_MAX_REQUEST_CTRLS + 1] = {};
+    bool owned[QORE_LDAP_MAX_REQUEST_CTRLS] = {};
+    int n = 0;
 
-            p = opth->getKeyValue("starttls");
-            tls = p.getAsBool();
+    DLLLOCAL QoreLdapControlList(const QoreLdapControlList&) = delete;
+    DLLLOCAL QoreLdapControlList& operator=(const QoreLdapControlList&) = delete;
+};
+
+// the state of a search whose entries are retrieved one at a time
+struct QoreLdapSearchStream {
+    // the search hash referenced by the search parameters
+    ReferenceHolder<QoreHashNode> h;
+    QoreLdapSearchParams sp;
+    // the paged results cookie for the next page
+    QoreLdapPageCookie cookie;
+    // the message ID of the current request; -1 if the search is complete
+    int msgid = -1;
+    // the session context generation of the current request; message IDs are reused by new session contexts
+    unsigned gen = 0;
+    // strings shared between the entries returned
+    QoreLdapInternTable intern;
+
+    DLLLOCAL QoreLdapSearchStream(const QoreHashNode& sh, ExceptionSink* xsink) : h(sh.hashRefSelf(), xsink), sp(xsink) {
+    }
+
+    // returns -1 if an exception was raised
+    DLLLOCAL int parse() {
+        if (sp.parse(**h))
+            return -1;
+        if (sp.vlv) {
+            sp.xsink->raiseException("LDAP-SEARCH-ERROR", "the 'vlv' option is only supported by LdapClient::search()");
+            return -1;
         }
+        return 0;
+    }
 
-        if (initIntern(xsink, "constructor", *uristr))
-            return;
+    // releases all references with the given exception sink and deletes the object
+    /** the exception sink given in the constructor may not be valid when the object is destroyed
+    */
+    DLLLOCAL void del(ExceptionSink* xsink) {
+        if (sp.attrl)
+            sp.attrl.release()->deref(xsink);
+        h.release()->deref(xsink);
+        delete this;
+    }
+};
 
-        if (opth) {
-            bindInitIntern(xsink, "constructor", *opth);
-            if (*xsink)
-                return;
+// decodes a search result entry in place from the BER-encoded message
+/** the DN, attribute names, and values point into the message buffer and are only valid while the message and the
+    decoder exist; liblber terminates in-place strings, so the DN and attribute names can be used as C strings
+*/
+class QoreLdapEntryDecoder {
+public:
+    DLLLOCAL QoreLdapEntryDecoder(LDAP* ldp, LDAPMessage* e) : ldp(ldp), e(e) {
+        if (ldap_get_dn_ber(ldp, e, &ber, &dn) != LDAP_SUCCESS || !dn.bv_val) {
+            dn.bv_val = (char*)"";
+            dn.bv_len = 0;
         }
     }
 
-    DLLLOCAL QoreLdapClient(const QoreLdapClient& old, ExceptionSink* xsink) : ldp(0), uri(0), bh(0), prot(old.prot), timeout_ms(old.timeout_ms), tls(old.tls), no_referrals(old.no_referrals) {
-        AutoLocker al(old.m);
-        if (old.checkValidIntern("copy", xsink))
-            return;
+    DLLLOCAL ~QoreLdapEntryDecoder() {
+        if (vals)
+            ber_memfree(vals);
+        if (ber)
+            ber_free(ber, 0);
+    }
 
-        if (initIntern(xsink, "copy", *old.uri))
-            return;
+    DLLLOCAL const berval& getDn() const {
+        return dn;
+    }
 
-        if (old.bh && bindInitIntern(xsink, "copy", *old.bh))
-            return;
+    // moves to the next attribute; returns false if there are no more attributes
+    DLLLOCAL bool next() {
+        if (vals) {
+            ber_memfree(vals);
+            vals = nullptr;
+        }
+        if (!ber)
+            return false;
+        berval bv;
+        if (ldap_get_attribute_ber(ldp, e, ber, &bv, &vals) != LDAP_SUCCESS || !bv.bv_val) {
+            attr = nullptr;
+            return false;
+        }
+        attr = bv.bv_val;
+        return true;
     }
 
-    DLLLOCAL ~QoreLdapClient() {
-        assert(!ldp);
-        assert(!uri);
-        assert(!bh);
+    // returns the name of the current attribute
+    DLLLOCAL const char* getName() const {
+        return attr;
     }
 
-    DLLLOCAL int destructor(ExceptionSink* xsink) {
-        AutoLocker al(m);
-        if (ldp) {
-            ldap_unbind_ext_s(ldp, 0, 0);
-            ldp = 0;
+    // returns the values of the current attribute terminated by a berval with a null bv_val; may be 0
+    DLLLOCAL const berval* getValues() const {
+        return vals;
+    }
+
+protected:
+    LDAP* ldp;
+    LDAPMessage* e;
+    BerElement* ber = nullptr;
+    berval dn;
+    const char* attr = nullptr;
+    BerVarray vals = nullptr;
+};
+
+class QoreLdapClient;
+
+class QoreLdapParseResultHelper {
+protected:
+    const char* meth;
+    const char* f;
+    QoreLdapClient* l;
+    ExceptionSink* xsink;
+    int err;
+    char* matched;
+    char* text;
+    char** refs;
+    LDAPControl** ctrls;
+
+public:
+    // parses the result; if \a get_ctrls is true, then server controls are also retrieved; if \a freeit is true, then the message is freed
+    DLLLOCAL QoreLdapParseResultHelper(const char *n_meth, const char* n_f, QoreLdapClient* n_l, LDAPMessage* msg, ExceptionSink* xs, bool get_ctrls = false, bool freeit = true);
+
+    DLLLOCAL ~QoreLdapParseResultHelper() {
+        if (matched)
+            ldap_memfree(matched);
+        if (text)
+            ldap_memfree(text);
+        if (refs)
+            ldap_memvfree((void**)refs);
+        if (ctrls)
+            ldap_controls_free(ctrls);
+    }
+
+    DLLLOCAL int getError() const {
+        return err;
+    }
+
+    // returns the diagnostic message from the server or 0 if none was returned
+    DLLLOCAL const char* getText() const {
+        return text && *text ? text : 0;
+    }
+
+    // returns the matched DN from the server or 0 if none was returned
+    DLLLOCAL const char* getMatched() const {
+        return matched && *matched ? matched : 0;
+    }
+
+    // returns the given server control from the result or 0 if not present
+    DLLLOCAL LDAPControl* findControl(const char* oid) const {
+        return ctrls ? ldap_control_find(oid, ctrls, 0) : 0;
+    }
+
+    // returns the description of the error in the result
+    DLLLOCAL QoreStringNode* getErrorDesc() const;
+
+    DLLLOCAL int check() const;
+};
+
+// default maximum number of outstanding requests in a batch
+#define QORE_LDAP_BATCH_DEFAULT_WINDOW 64
+
+// an operation in a batch
+struct QoreLdapBatchOp {
+    qore_ldap_op_e type;
+    // the operation name as given in the batch
+    const char* name;
+    const QoreStringNode* dn;
+    // attributes for add operations
+    const QoreHashNode* attr = nullptr;
+    // modifications for modify operations
+    const QoreListNode* mods = nullptr;
+    // rename arguments
+    const QoreStringNode* newrdn = nullptr;
+    const QoreStringNode* newparent = nullptr;
+    bool deleteoldrdn = true;
+
+    // parses an operation hash; returns -1 if an exception was raised
+    DLLLOCAL int parse(const QoreHashNode& h, size_t i, ExceptionSink* xsink) {
+        const QoreStringNode* op = check_hash_key<QoreStringNode>(xsink, h, "op", "LDAP-BATCH-ERROR");
+        if (*xsink)
+            return -1;
+        if (!op) {
+            xsink->raiseException("LDAP-BATCH-ERROR", "operation %d is missing the 'op' key", (int)i);
+            return -1;
+        }
+        name = op->c_str();
+        if (!strcmp(name, "add"))
+            type = QLO_ADD;
+        else if (!strcmp(name, "modify"))
+            type = QLO_MODIFY;
+        else if (!strcmp(name, "del"))
+            type = QLO_DELETE;
+        else if (!strcmp(name, "rename"))
+            type = QLO_RENAME;
+        else {
+            xsink->raiseException("LDAP-BATCH-ERROR", "operation %d has unsupported 'op' value '%s'; expecting one of 'add', 'modify', 'del', or 'rename'", (int)i, name);
+            return -1;
         }
 
-        if (uri) {
-            uri->deref();
-            uri = 0;
+        dn = check_hash_key<QoreStringNode>(xsink, h, "dn", "LDAP-BATCH-ERROR");
+        if (*xsink)
+            return -1;
+        if (!dn) {
+            xsink->raiseException("LDAP-BATCH-ERROR", "%s operation %d is missing the 'dn' key", name, (int)i);
+            return -1;
+        }
+
+        switch (type) {
+            case QLO_ADD:
+                attr = check_hash_key<QoreHashNode>(xsink, h, "attributes", "LDAP-BATCH-ERROR");
+                if (!*xsink && !attr)
+                    xsink->raiseException("LDAP-BATCH-ERROR", "add operation %d is missing the 'attributes' key", (int)i);
+                break;
+            case QLO_MODIFY:
+                mods = check_hash_key<QoreListNode>(xsink, h, "mods", "LDAP-BATCH-ERROR");
+                if (!*xsink && !mods)
+                    xsink->raiseException("LDAP-BATCH-ERROR", "modify operation %d is missing the 'mods' key", (int)i);
+                break;
+            case QLO_RENAME:
+                newrdn = check_hash_key<QoreStringNode>(xsink, h, "newrdn", "LDAP-BATCH-ERROR");
+                if (*xsink)
+                    break;
+                newparent = check_hash_key<QoreStringNode>(xsink, h, "newparent", "LDAP-BATCH-ERROR");
+                if (*xsink)
+                    break;
+                if (!newrdn || !newparent) {
+                    xsink->raiseException("LDAP-BATCH-ERROR", "rename operation %d requires the 'newrdn' and 'newparent' keys", (int)i);
+                    break;
+                }
+                {
+                    QoreValue v = h.getKeyValue("deleteoldrdn");
+                    if (!v.isNothing())
+                        deleteoldrdn = v.getAsBool();
+                }
+                break;
+            default:
+                break;
+        }
+        return *xsink ? -1 : 0;
+    }
+};
+
+// a sync info message received by a content synchronization search (RFC 4533)
+struct QoreLdapSyncInfo {
+    // the message type
+    ber_tag_t tag = 0;
+    // the new cookie, if any
+    std::string cookie;
+    // the refreshDone flag of refreshDelete and refreshPresent messages
+    bool refresh_done = true;
+    // the refreshDeletes flag and entryUUIDs of syncIdSet messages
+    bool refresh_deletes = false;
+    std::vector<std::string> uuids;
+};
+
+// the c++ object
+class QoreLdapClient : public AbstractPrivateData {
+    friend class QoreLdapParseResultHelper;
+    friend class QoreLdapSyncConsumer;
+
+protected:
+    // ldap context
+    LDAP* ldp;
+    // mutual-exclusion lock; in multiplexed mode only held while sending requests and routing responses
+    mutable QoreThreadLock m;
+    // protects the session context from being destroyed while responses are read without the lock in multiplexed mode
+    QoreRWLock rwl;
+    // signaled when responses have been routed to pending operations in multiplexed mode
+    QoreCondition pcond;
+    // operations waiting for responses in multiplexed mode
+    ldap_pending_map_t pending;
+    // asynchronous operations that were pending when the session context was reinitialized; kept with an error
+    // until they are retrieved or abandoned
+    ldap_orphan_map_t orphans;
+    // saved URI
+    QoreStringNode* uri;
+    // saved bind parameters
+    QoreHashNode* bh;
+    // ldap protocol version
+    int prot;
+    // ldap default timeout in ms
+    int timeout_ms;
+    // allow multiple requests to be in flight at the same time; set in the constructor and read without the lock
+    const bool multiplex;
+    // attribute value types from the server's schema; loaded on demand and cleared when the session is rebound
+    std::shared_ptr<const ldap_schema_type_map_t> schema_types;
+    // the search result cache, if any; shared by all sessions in a pool
+    std::shared_ptr<QoreLdapSearchCache> cache;
+    // the servers to select from for new connections, if more than one is configured; shared by all sessions in a
+    // pool
+    std::shared_ptr<QoreLdapServerSet> servers;
+    // the index of the server the session is connected to in the server set
+    std::atomic<int> server_idx{-1};
+    // operation statistics
+    QoreLdapStats stats;
+    // the callback for slow operations, if any
+    ResolvedCallReferenceNode* slow_cb = nullptr;
+    // the slow operation threshold in microseconds
+    int64 slow_us = 0;
+    // incremented each time the session is reconnected after the connection was lost; protected by the lock
+    unsigned conn_gen = 0;
+    // incremented each time the session context is reinitialized; included in the handles of asynchronous
+    // operations, because message IDs are reused by the new session context
+    unsigned ctx_gen = 0;
+    // the number of times idempotent operations are retried after reconnecting
+    int max_retries = QORE_LDAP_DEFAULT_MAX_RETRIES;
+    // the initial delay before reconnecting in milliseconds
+    int retry_delay_ms = QORE_LDAP_DEFAULT_RETRY_DELAY_MS;
+    // boolean flags
+    bool tls : 1,        // issue a STARTTLS command if the session is not already secure
+        no_referrals : 1, // do not follow referrals
+        reading : 1,      // a thread is reading responses from the session in multiplexed mode
+        reconnect : 1,    // reconnect automatically when the connection is lost
+        lazy : 1,         // the connection has not been made yet; it's made when the first request is sent
+        fast_bind : 1,    // bind on the current connection instead of making a new connection
+        restore_bind : 1; // the saved identity must be restored before the next request after checkBind()
+
+    // locks the session for a single operation and retrieves the operation's responses
+    class OpHelper {
+    public:
+        DLLLOCAL OpHelper(QoreLdapClient* l, const char* meth, ExceptionSink* xsink) : l(l), meth(meth), xsink(xsink), timer(l->stats, xsink) {
+        }
+
+        DLLLOCAL ~OpHelper() {
+            if (locked)
+                l->m.unlock();
+            if (rd)
+                l->rwl.unlock();
+            l->traceDone(timer, xsink);
+            // slow operations that were completed while the lock was held
+            for (auto& i : traces)
+                l->callSlowCallback(i, xsink);
+        }
+
+        // records an operation completed while the lock is held; the slow operation callback is called for it when
+        // the lock is released
+        DLLLOCAL void traceOp(QoreLdapOpTimer& t) {
+            addTrace(l->traceDoneIntern(t, xsink));
+        }
+
+        // adds a trace for the slow operation callback to be called when the lock is released; ignores 0
+        DLLLOCAL void addTrace(QoreHashNode* trace) {
+            if (trace)
+                traces.push_back(trace);
+        }
+
+        // sets the DN of the request for slow operation tracing; the string must remain valid while the helper exists
+        DLLLOCAL void setTarget(const QoreStringNode* dn) {
+            timer.dn = dn;
+        }
+
+        // sets the search base and filter for slow operation tracing
+        DLLLOCAL void setSearch(const QoreStringNode* base, const QoreStringNode* filter) {
+            timer.base = base;
+            timer.filter = filter;
+        }
+
+        // locks the session; returns -1 if an exception was raised
+        /** called after request arguments have been converted so that the lock is held for as short a time as
+            possible; returns 0 immediately if the lock is already held
+        */
+        DLLLOCAL int lock() {
+            // the lock may already be held when sending subsequent pages of a paged search
+            if (locked) {
+                timer.phase(QLP_SEND);
+                return 0;
+            }
+            timer.phase(QLP_LOCK);
+            if (l->multiplex) {
+                l->rwl.rdlock();
+                rd = true;
+            }
+            l->m.lock();
+            locked = true;
+            timer.phase(QLP_SEND);
+            if (l->checkValidIntern(meth, xsink))
+                return -1;
+            if (l->lazy && l->connectIntern(meth, xsink))
+                return -1;
+            return l->restore_bind ? l->restoreBindIntern(meth, xsink) : 0;
+        }
+
+        // registers an operation for asynchronous retrieval of its responses and returns its handle
+        DLLLOCAL int64 registerAsync(int msgid, const char* f, qore_ldap_op_e type) {
+            assert(locked);
+            QoreLdapPendingOp* op = l->registerOpIntern(msgid, meth, f, type, true);
+            op->inval.swap(inval);
+            return l->getHandleIntern(msgid);
+        }
+
+        // registers the current request of a search whose entries are retrieved one at a time
+        DLLLOCAL void registerStream(QoreLdapSearchStream& ss, int msgid) {
+            assert(locked);
+            l->registerOpIntern(msgid, meth, "ldap_search_ext", QLO_SEARCH, false);
+            ss.msgid = msgid;
+            ss.gen = l->ctx_gen;
+        }
+
+        // invalidates the given DN in the search cache and saves it to invalidate again when the operation completes
+        DLLLOCAL void invalidate(const char* dn) {
+            if (!l->cache)
+                return;
+            l->cache->invalidate(dn);
+            inval.push_back(dn);
+        }
+
+        // invalidates the DNs affected by the operation in the search cache again after it has completed
+        /** searches executed while the operation was in progress could have cached stale results
+        */
+        DLLLOCAL void invalidateDone() {
+            for (auto& i : inval)
+                l->cache->invalidate(i.c_str());
+            inval.clear();
+        }
+
+        // returns the DNs to invalidate when the operation completes
+        DLLLOCAL void takeInval(std::vector<std::string>& v) {
+            v.swap(inval);
+            inval.clear();
+        }
+
+        // returns the final response for the given message ID or 0 if an exception was raised
+        DLLLOCAL LDAPMessage* getResult(const char* f, qore_ldap_op_e type, int msgid, int my_timeout_ms) {
+            QoreLdapMessageList res;
+            if (getResults(f, type, msgid, my_timeout_ms, res))
+                return 0;
+            assert(!res.empty());
+            LDAPMessage* msg = res.back();
+            res.pop_back();
+            return msg;
+        }
+
+        // retrieves all responses for the given message ID; returns -1 if an exception was raised
+        /** the operation is recorded in the session's statistics when the helper goes out of scope
+        */
+        DLLLOCAL int getResults(const char* f, qore_ldap_op_e type, int msgid, int my_timeout_ms, QoreLdapMessageList& res) {
+            timer.setOp((qore_ldap_stat_op_e)type);
+            timer.msgid = msgid;
+            timer.phase(QLP_WAIT);
+            int rc = getResultsIntern(f, type, msgid, my_timeout_ms, res);
+            timer.phase(QLP_DECODE);
+            return rc;
+        }
+
+        // adds the number of entries and attribute value bytes returned to the operation's statistics
+        DLLLOCAL void addResults(int64 entries, int64 bytes) {
+            timer.addResults(entries, bytes);
+        }
+
+    protected:
+        QoreLdapClient* l;
+        const char* meth;
+        ExceptionSink* xsink;
+        // DNs to invalidate in the search cache when the operation completes
+        std::vector<std::string> inval;
+        // times the phases of the operation
+        QoreLdapOpTimer timer;
+        // traces of slow operations completed while the lock was held
+        std::vector<QoreHashNode*> traces;
+        // set if the read lock is held
+        bool rd = false;
+        // set if the session lock is held
+        bool locked = false;
+
+        DLLLOCAL int getResultsIntern(const char* f, qore_ldap_op_e type, int msgid, int my_timeout_ms, QoreLdapMessageList& res) {
+            assert(locked);
+            // a timeout of 0 means the default timeout in both modes
+            if (!my_timeout_ms)
+                my_timeout_ms = l->timeout_ms;
+            if (!l->multiplex) {
+                LDAPMessage* msg = 0;
+                TimeoutHelper timeout(my_timeout_ms);
+
+                int rc = ldap_result(l->ldp, msgid, LDAP_MSG_ALL, &timeout, &msg);
+                if (l->checkLdapResult(meth, f, rc, xsink)) {
+                    assert(!msg);
+                    timer.result = rc ? rc : LDAP_TIMEOUT;
+                    return -1;
+                }
+                res.push_back(msg);
+                getResultCode(msg);
+                return 0;
+            }
+
+            // the operation must be registered before the lock is released so that responses can be routed to it
+            QoreLdapPendingOp* op = l->registerOpIntern(msgid, meth, f, type, false);
+            int rc = l->waitOpIntern(msgid, true, my_timeout_ms, op);
+            // internal operations are only removed by the thread that registered them
+            assert(op);
+            int err = op->err;
+            for (auto& i : op->msgs)
+                res.push_back(i);
+            op->msgs.clear();
+            l->removeOpIntern(msgid);
+
+            if (!rc) {
+                timer.result = LDAP_TIMEOUT;
+                l->doLdapError(meth, f, LDAP_TIMEOUT, xsink);
+                return -1;
+            }
+            if (rc < 0) {
+                timer.result = err;
+                l->doLdapError(meth, f, err, xsink);
+                return -1;
+            }
+            if (!res.empty())
+                getResultCode(res.back());
+            return 0;
+        }
+
+        // saves the result code of the given final response for slow operation tracing
+        DLLLOCAL void getResultCode(LDAPMessage* msg) {
+            if (!l->slow_cb)
+                return;
+            int err;
+            if (ldap_parse_result(l->ldp, msg, &err, 0, 0, 0, 0, 0) == LDAP_SUCCESS)
+                timer.result = err;
+        }
+    };
+
+    QoreStringNode* getErrorText(const char* meth, const char* f, int ec) const {
+        QoreStringNode* desc = new QoreStringNode("ldap server ");
+        if (uri)
+            desc->sprintf("'%s' ", uri->getBuffer());
+        desc->sprintf("returned error code %d", ec);
+        desc->sprintf(" when calling %s() in LdapClient::%s(): %s", f, meth, ldap_err2string(ec));
+        return desc;
+    }
+
+    void doLdapError(const char* meth, const char* f, int ec, ExceptionSink* xsink) const {
+        xsink->raiseException("LDAP-ERROR", getErrorText(meth, f, ec));
+    }
+
+    int checkLdapError(const char* meth, const char* f, int ec, ExceptionSink* xsink) const {
+        //printd(5, "QoreLdapClient::checkLdapError() %s() rc: %d\n", f, ec);
+        if (ec == LDAP_SUCCESS)
+            return 0;
+        doLdapError(meth, f, ec, xsink);
+        return -1;
+    }
+
+    DLLLOCAL int checkFreeResult(const char* meth, const char* f, LDAPMessage* res, ExceptionSink* xsink) {
+        QoreLdapParseResultHelper prh(meth, f, this, res, xsink);
+        if (*xsink)
+            return -1;
+        return prh.check();
+    }
+
+    int checkLdapResult(const char* meth, const char* f, int ec, ExceptionSink* xsink) const {
+        //printd(5, "QoreLdapClient::checkLdapResult() rc: %d\n", ec);
+        // timeout
+        if (!ec) {
+            doLdapError(meth, f, LDAP_TIMEOUT, xsink);
+            return -1;
+        }
+        if (ec == -1) {
+            doLdapError(meth, f, ec, xsink);
+            return -1;
+        }
+        return 0;
+    }
+
+    DLLLOCAL int checkValidIntern(const char* m, ExceptionSink* xsink) const {
+        if (!ldp && !lazy) {
+            xsink->raiseException("LDAP-NO-CONTEXT", "cannot execute LdapClient::%s(); the LdapClient object has been destroyed or the session context has been unbound", m);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    // returns true if the result code of the last operation shows that the connection was lost; the lock must be
+    // held
+    DLLLOCAL bool isConnectionDownIntern() const {
+        if (!ldp)
+            return false;
+        int err = LDAP_SUCCESS;
+        ldap_get_option(ldp, LDAP_OPT_RESULT_CODE, &err);
+        return err == LDAP_SERVER_DOWN || err == LDAP_CONNECT_ERROR;
+    }
+
+    // registers an operation for response routing; the lock must be held
+    DLLLOCAL QoreLdapPendingOp* registerOpIntern(int msgid, const char* meth, const char* f, qore_ldap_op_e type, bool async) {
+        assert(pending.find(msgid) == pending.end());
+        QoreLdapPendingOp* op = new QoreLdapPendingOp(meth, f, type, async);
+        pending[msgid] = op;
+        return op;
+    }
+
+    // removes an operation from the routing table and abandons it if it's not complete; the lock must be held
+    DLLLOCAL void removeOpIntern(int msgid) {
+        ldap_pending_map_t::iterator i = pending.find(msgid);
+        assert(i != pending.end());
+        if (!i->second->done)
+            ldap_abandon_ext(ldp, msgid, 0, 0);
+        delete i->second;
+        pending.erase(i);
+    }
+
+    // fails all pending operations with the given error code; the lock must be held
+    DLLLOCAL void failPendingIntern(int ec) {
+        for (auto& i : pending) {
+            if (!i.second->done) {
+                i.second->err = ec;
+                i.second->done = true;
+            }
+        }
+    }
+
+    // reads one response from the session and routes it to its pending operation; the lock must be held
+    /** in multiplexed mode the lock is released while waiting for the response
+
+        @return the return value of ldap_result(): 0 = timeout, -1 = error, otherwise the message type
+    */
+    DLLLOCAL int readIntern(int my_timeout_ms) {
+        assert(!reading);
+        reading = true;
+        TimeoutHelper timeout(my_timeout_ms);
+        LDAPMessage* msg = 0;
+        if (multiplex)
+            m.unlock();
+        int rc = ldap_result(ldp, LDAP_RES_ANY, LDAP_MSG_ONE, &timeout, &msg);
+        if (multiplex)
+            m.lock();
+        reading = false;
+
+        if (rc > 0) {
+            ldap_pending_map_t::iterator i = pending.find(ldap_msgid(msg));
+            // responses for abandoned operations are discarded
+            if (i == pending.end())
+                ldap_msgfree(msg);
+            else {
+                i->second->msgs.push_back(msg);
+                if (rc != LDAP_RES_SEARCH_ENTRY && rc != LDAP_RES_SEARCH_REFERENCE && rc != LDAP_RES_INTERMEDIATE)
+                    i->second->done = true;
+            }
+        }
+        else if (rc < 0) {
+            int ec = LDAP_SERVER_DOWN;
+            ldap_get_option(ldp, LDAP_OPT_RESULT_CODE, &ec);
+            failPendingIntern(ec);
+        }
+
+        if (multiplex)
+            pcond.broadcast();
+        return rc;
+    }
+
+    // waits until responses are available for the given operation; the lock must be held
+    /** if no other thread is reading from the session, then the current thread reads responses and routes them to
+        their operations; otherwise it waits for the reading thread to deliver its responses
+
+        the operation is looked up by its message ID after every wait, because the lock is released while waiting,
+        and the operation can be removed by another thread in the meantime
+
+        @param msgid the message ID of the operation
+        @param all if true then wait for the final response, otherwise wait for the next response
+        @param op set to the operation, or to nullptr if it was removed while waiting
+
+        @return 0 = timeout, -1 = the session failed or the operation was removed, 1 = responses are available
+    */
+    DLLLOCAL int waitOpIntern(int msgid, bool all, int my_timeout_ms, QoreLdapPendingOp*& op) {
+        int64 start = q_clock_getmicros();
+        while (true) {
+            ldap_pending_map_t::iterator i = pending.find(msgid);
+            if (i == pending.end()) {
+                op = nullptr;
+                return -1;
+            }
+            op = i->second;
+
+            if (!op->msgs.empty() && (!all || op->done))
+                return 1;
+            if (op->done)
+                return op->err == LDAP_SUCCESS ? 1 : -1;
+
+            int remaining = my_timeout_ms - (int)((q_clock_getmicros() - start) / 1000);
+            if (remaining <= 0)
+                return 0;
+
+            if (!reading)
+                readIntern(remaining);
+            else
+                pcond.wait(&m, remaining);
+        }
+    }
+
+    // returns the asynchronous operation for the given handle; the lock must be held
+    /** operations that failed when the session context was reinitialized are also returned
+    */
+    DLLLOCAL QoreLdapPendingOp* getAsyncOpIntern(const char* meth, int64 handle, ExceptionSink* xsink) const {
+        QoreLdapPendingOp* op = nullptr;
+        int msgid = getMsgidIntern(handle);
+        if (msgid != -1) {
+            ldap_pending_map_t::const_iterator i = pending.find(msgid);
+            if (i != pending.end() && i->second->async)
+                op = i->second;
+        } else {
+            ldap_orphan_map_t::const_iterator i = orphans.find(handle);
+            if (i != orphans.end())
+                op = i->second;
+        }
+        if (!op) {
+            xsink->raiseException("LDAP-ASYNC-ERROR", "LdapClient::%s(): handle " QLLD " does not identify a pending asynchronous operation", meth, handle);
+            return 0;
+        }
+        if (op->claimed) {
+            xsink->raiseException("LDAP-ASYNC-ERROR", "LdapClient::%s(): the operation with handle " QLLD " is being waited for in another thread", meth, handle);
+            return 0;
+        }
+        return op;
+    }
+
+    // removes a completed asynchronous operation and returns its result; the lock must be held
+    /** the operation is recorded in the statistics and traced when the lock is released; the wait phase covers the
+        time from sending the request until its responses were retrieved
+    */
+    DLLLOCAL QoreValue completeAsyncIntern(OpHelper& oh, int64 handle, QoreLdapPendingOp* op, ExceptionSink* xsink) {
+        assert(op->done);
+        QoreLdapOpTimer t(stats, xsink, (qore_ldap_stat_op_e)op->type, QLP_WAIT, op->sent);
+        t.msgid = (int)(handle & 0xffffffff);
+        t.result = op->err;
+        QoreValue rv = getAsyncResultIntern(handle, op, t, xsink);
+        oh.traceOp(t);
+        return rv;
+    }
+
+    // removes a completed asynchronous operation and returns its result; the lock must be held
+    DLLLOCAL QoreValue getAsyncResultIntern(int64 handle, QoreLdapPendingOp* op, QoreLdapOpTimer& t, ExceptionSink* xsink) {
+        const char* meth = op->meth;
+        const char* f = op->f;
+        qore_ldap_op_e type = op->type;
+        int err = op->err;
+        QoreLdapResultOpts ropts = std::move(op->ropts);
+        // the requested attributes are the columns of columnar results
+        ReferenceHolder<QoreListNode> attrl(xsink);
+        if (!op->attrs.empty()) {
+            attrl = new QoreListNode(autoTypeInfo);
+            for (auto& i : op->attrs)
+                attrl->push(new QoreStringNode(i), xsink);
+        }
+        for (auto& i : op->inval)
+            cache->invalidate(i.c_str());
+
+        QoreLdapMessageList res;
+        for (auto& i : op->msgs)
+            res.push_back(i);
+        op->msgs.clear();
+        removeAsyncOpIntern(handle);
+
+        if (err != LDAP_SUCCESS) {
+            doLdapError(meth, f, err, xsink);
+            return QoreValue();
+        }
+        assert(!res.empty());
+
+        t.phase(QLP_DECODE);
+        if (type == QLO_SEARCH)
+            return makeSearchResultIntern(res, ropts, *attrl, xsink, &t);
+
+        LDAPMessage* msg = res.back();
+        res.pop_back();
+        if (type == QLO_COMPARE)
+            return compareResultIntern(meth, f, msg, xsink);
+
+        checkFreeResult(meth, f, msg, xsink);
+        return QoreValue();
+    }
+
+    // adds the entries in the given response messages to the search result
+    DLLLOCAL int addSearchResultIntern(QoreLdapSearchResult& r, QoreLdapMessageList& res, ExceptionSink* xsink) {
+        // in multiplexed mode each entry is received in a separate message
+        for (auto& msg : res) {
+            //printd(5, "LdapClient::search() results: %d entries: %d\n", ldap_count_messages(ldp, msg), ldap_count_entries(ldp, msg));
+            for (LDAPMessage* e = ldap_first_entry(ldp, msg); e; e = ldap_next_entry(ldp, e)) {
+                if (addEntryIntern(r, e, xsink))
+                    return -1;
+            }
+        }
+        return 0;
+    }
+
+    // makes the search result in the requested format from the given response messages
+    /** if \a t is not 0, then the number of entries and bytes returned are added to the operation's statistics
+    */
+    DLLLOCAL QoreValue makeSearchResultIntern(QoreLdapMessageList& res, const QoreLdapResultOpts& ropts, const QoreListNode* attrl, ExceptionSink* xsink, QoreLdapOpTimer* t = nullptr) {
+        QoreLdapSearchResult r(ropts, attrl, xsink);
+        if (addSearchResultIntern(r, res, xsink))
+            return QoreValue();
+        if (t)
+            t->addResults(r.size(), r.bytes);
+        return r.release();
+    }
+
+    // returns the search result message in the given response messages or 0 if not present
+    DLLLOCAL LDAPMessage* findSearchResultIntern(QoreLdapMessageList& res) {
+        for (auto& i : res) {
+            for (LDAPMessage* msg = ldap_first_message(ldp, i); msg; msg = ldap_next_message(ldp, msg)) {
+                if (ldap_msgtype(msg) == LDAP_RES_SEARCH_RESULT)
+                    return msg;
+            }
+        }
+        return 0;
+    }
+
+    // gets the paged results cookie for the next page from the search result; returns -1 if an exception was raised
+    /** the cookie is cleared if there are no more pages to retrieve
+    */
+    DLLLOCAL int getPageCookieIntern(const char* meth, LDAPMessage* res, QoreLdapPageCookie& cookie, ExceptionSink* xsink) {
+        cookie.clear();
+
+        QoreLdapParseResultHelper prh(meth, "ldap_search_ext", this, res, xsink, true, false);
+        if (*xsink || prh.check())
+            return -1;
+
+        // if the server does not return the control, then it does not support paging and all results were returned
+        LDAPControl* ctrl = prh.findControl(LDAP_CONTROL_PAGEDRESULTS);
+        if (!ctrl)
+            return 0;
+
+        ber_int_t count;
+        return checkLdapError(meth, "ldap_parse_pageresponse_control", ldap_parse_pageresponse_control(ldp, ctrl, &count, &cookie), xsink);
+    }
+
+    DLLLOCAL int getPageCookieIntern(const char* meth, QoreLdapMessageList& res, QoreLdapPageCookie& cookie, ExceptionSink* xsink) {
+        LDAPMessage* msg = findSearchResultIntern(res);
+        if (!msg) {
+            cookie.clear();
+            return 0;
+        }
+        return getPageCookieIntern(meth, msg, cookie, xsink);
+    }
+
+    // returns the result of a compare operation and frees the message
+    /** if \a nso is not 0 and the entry does not exist, then the error description is also returned in \a nso
+    */
+    DLLLOCAL bool compareResultIntern(const char* meth, const char* f, LDAPMessage* res, ExceptionSink* xsink, QoreStringNode** nso = nullptr) {
+        QoreLdapParseResultHelper prh(meth, f, this, res, xsink);
+        if (*xsink)
+            return false;
+
+        int rc = prh.getError();
+        if (rc == LDAP_COMPARE_TRUE)
+            return true;
+        if (rc == LDAP_COMPARE_FALSE)
+            return false;
+
+        if (nso && rc == LDAP_NO_SUCH_OBJECT) {
+            QoreStringNode* desc = prh.getErrorDesc();
+            *nso = desc->stringRefSelf();
+            xsink->raiseException("LDAP-RESULT-ERROR", desc);
+            return false;
+        }
+
+        prh.check();
+        return false;
+    }
+
+    // returns the cache key and the UTF-8 DN for a compare operation; returns -1 if an exception was raised
+    DLLLOCAL static int getCompareKeyIntern(const QoreStringNode* dn, const QoreStringNode* attr, const QoreListNode* vl, std::string& key, std::string& dnutf8, ExceptionSink* xsink) {
+        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+        dnutf8 = dnstr->c_str();
+        QoreStringValueHelper attrstr(attr, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        // the leading NUL character separates compare keys from search keys
+        key.assign(1, '\0');
+        key += QoreLdapSearchCache::normalizeDn(dnstr->c_str());
+        key += '\0';
+        key += QoreLdapResultOpts::getKey(attrstr->c_str());
+        if (!vl)
+            return 0;
+
+        QoreLdapArena arena;
+        ConstListIterator li(vl);
+        while (li.next()) {
+            berval bv;
+            if (q_ldap_set_berval(arena, bv, li.getValue(), xsink))
+                return -1;
+            key += '\0';
+            key.append(bv.bv_val, bv.bv_len);
+        }
+        return 0;
+    }
+
+    // parses the given number of digits; returns -1 if the value is invalid
+    DLLLOCAL static int parseDigits(const char*& p, const char* e, int n) {
+        if (e - p < n)
+            return -1;
+        int rv = 0;
+        for (int i = 0; i < n; ++i, ++p) {
+            if (!isdigit((unsigned char)*p))
+                return -1;
+            rv = rv * 10 + (*p - '0');
+        }
+        return rv;
+    }
+
+    // returns a date for the given GeneralizedTime value or 0 if the value is invalid
+    /** format: YYYYMMDDHH[MM[SS]][(.|,)fraction](Z|(+|-)HH[MM])
+    */
+    DLLLOCAL static DateTimeNode* parseGeneralizedTime(const char* p, size_t len) {
+        const char* e = p + len;
+        int year = parseDigits(p, e, 4);
+        int month = parseDigits(p, e, 2);
+        int day = parseDigits(p, e, 2);
+        int hour = parseDigits(p, e, 2);
+        if (year < 0 || month < 0 || day < 0 || hour < 0)
+            return 0;
+        int minute = 0, second = 0, us = 0;
+        if (p < e && isdigit((unsigned char)*p)) {
+            if ((minute = parseDigits(p, e, 2)) < 0)
+                return 0;
+            if (p < e && isdigit((unsigned char)*p) && (second = parseDigits(p, e, 2)) < 0)
+                return 0;
+        }
+        if (p < e && (*p == '.' || *p == ',')) {
+            ++p;
+            // the fraction is truncated to microseconds
+            int digits = 0;
+            while (p < e && isdigit((unsigned char)*p)) {
+                if (digits < 6) {
+                    us = us * 10 + (*p - '0');
+                    ++digits;
+                }
+                ++p;
+            }
+            if (!digits)
+                return 0;
+            while (digits++ < 6)
+                us *= 10;
+        }
+        if (p == e)
+            return 0;
+        int offset = 0;
+        if (*p == 'Z')
+            ++p;
+        else if (*p == '+' || *p == '-') {
+            int sign = *p++ == '-' ? -1 : 1;
+            int oh = parseDigits(p, e, 2);
+            int om = p < e ? parseDigits(p, e, 2) : 0;
+            if (oh < 0 || om < 0)
+                return 0;
+            offset = sign * (oh * 3600 + om * 60);
+        }
+        else
+            return 0;
+        if (p != e)
+            return 0;
+
+        return DateTimeNode::makeAbsolute(findCreateOffsetZone(offset), year, month, day, hour, minute, second, us);
+    }
+
+    // returns a typed value for the given attribute value or no value if the value cannot be converted
+    DLLLOCAL static QoreValue makeTypedValueIntern(const berval* bv, qore_ldap_value_type_e type) {
+        switch (type) {
+            case QLT_INT: {
+                if (!bv->bv_len || bv->bv_len > 20)
+                    return QoreValue();
+                char buf[21];
+                memcpy(buf, bv->bv_val, bv->bv_len);
+                buf[bv->bv_len] = '\0';
+                char* end;
+                errno = 0;
+                long long i = strtoll(buf, &end, 10);
+                if (*end || errno)
+                    return QoreValue();
+                return (int64)i;
+            }
+
+            case QLT_BOOL:
+                if (bv->bv_len == 4 && !strncmp(bv->bv_val, "TRUE", 4))
+                    return true;
+                if (bv->bv_len == 5 && !strncmp(bv->bv_val, "FALSE", 5))
+                    return false;
+                return QoreValue();
+
+            case QLT_DATE:
+                return parseGeneralizedTime(bv->bv_val, bv->bv_len);
+
+            default:
+                return QoreValue();
+        }
+    }
+
+    // returns a value for the given attribute value
+    /** values that cannot be converted to the given type are returned as strings
+    */
+    DLLLOCAL static QoreValue makeValueIntern(const berval* bv, bool bin, qore_ldap_value_type_e type = QLT_STRING) {
+        if (bin) {
+            // copied directly from the berval without conversion
+            BinaryNode* b = new BinaryNode;
+            b->append(bv->bv_val, bv->bv_len);
+            return b;
+        }
+        if (type != QLT_STRING) {
+            QoreValue rv = makeTypedValueIntern(bv, type);
+            if (!rv.isNothing())
+                return rv;
+        }
+        return new QoreStringNode(bv->bv_val, bv->bv_len, QCS_UTF8);
+    }
+
+    // returns a value for the given attribute value, shared with earlier equal values in the given intern table if
+    // possible
+    DLLLOCAL static QoreValue makeValueIntern(const berval* bv, QoreLdapInternTable::AttrInfo& ai, QoreLdapInternTable* it) {
+        if (ai.bin)
+            return makeValueIntern(bv, true);
+        if (ai.type != QLT_STRING) {
+            QoreValue rv = makeTypedValueIntern(bv, ai.type);
+            if (!rv.isNothing())
+                return rv;
+        }
+        return it->getString(ai, bv);
+    }
+
+    // calls the given function with the name and value of each attribute of the given search result entry
+    /** if \a always_list is false, single values are returned directly, otherwise all values are returned as
+        lists; if \a bytes is not 0, then the size of all values is added to it; if \a it is not 0, then attribute
+        options are looked up and repeated string values are shared with the given intern table
+    */
+    template <typename F>
+    DLLLOCAL void forEachAttrIntern(QoreLdapEntryDecoder& d, const QoreLdapResultOpts* ropts, bool always_list, F f, ExceptionSink* xsink, size_t* bytes = nullptr, QoreLdapInternTable* it = nullptr) {
+        while (d.next()) {
+            const char* attr = d.getName();
+            QoreLdapInternTable::AttrInfo ai_local;
+            QoreLdapInternTable::AttrInfo* ai;
+            if (it)
+                ai = &it->getAttr(attr, ropts);
+            else {
+                ai = &ai_local;
+                if (ropts) {
+                    ai->bin = ropts->isBinary(attr);
+                    if (!ai->bin)
+                        ai->type = ropts->getType(attr);
+                }
+            }
+
+            auto make_value = [&] (const berval* v) -> QoreValue {
+                return it ? makeValueIntern(v, *ai, it) : makeValueIntern(v, ai->bin, ai->type);
+            };
+
+            QoreValue aval;
+            const berval* vals = d.getValues();
+            if (vals && vals[0].bv_val) {
+                if (bytes) {
+                    for (const berval* v = vals; v->bv_val; ++v)
+                        *bytes += v->bv_len;
+                }
+                if (!always_list && !vals[1].bv_val)
+                    aval = make_value(&vals[0]);
+                else {
+                    QoreListNode* al = new QoreListNode(autoTypeInfo);
+                    for (const berval* v = vals; v->bv_val; ++v)
+                        al->push(make_value(v), xsink);
+                    aval = al;
+                }
+            }
+
+            f(attr, aval);
+        }
+    }
+
+    // returns a hash of the attributes of the given search result entry
+    DLLLOCAL QoreHashNode* getEntryAttrsIntern(QoreLdapEntryDecoder& d, ExceptionSink* xsink, const QoreLdapResultOpts* ropts = nullptr, bool always_list = false, size_t* bytes = nullptr, QoreLdapInternTable* it = nullptr) {
+        ReferenceHolder<QoreHashNode> he(new QoreHashNode, xsink);
+        forEachAttrIntern(d, ropts, always_list, [&] (const char* attr, QoreValue v) {
+            he->setKeyValue(attr, v, 0);
+        }, xsink, bytes, it);
+        return he.release();
+    }
+
+    // adds the given search result entry to the result in the requested format
+    DLLLOCAL int addEntryIntern(QoreLdapSearchResult& r, LDAPMessage* e, ExceptionSink* xsink) {
+        QoreLdapEntryDecoder d(ldp, e);
+        r.bytes += d.getDn().bv_len;
+        switch (r.getFormat()) {
+            case QLF_HASH: {
+                QoreHashNode* he = getEntryAttrsIntern(d, xsink, &r.getOpts(), false, &r.bytes, &r.getInternTable());
+                if (!he)
+                    return -1;
+                r.addHash(d.getDn().bv_val, he);
+                break;
+            }
+
+            case QLF_LIST: {
+                QoreHashNode* entry = makeEntryIntern(d, xsink, &r.getOpts(), true, &r.bytes, &r.getInternTable());
+                if (!entry)
+                    return -1;
+                r.addList(entry);
+                break;
+            }
+
+            case QLF_COLUMNAR: {
+                r.beginColumnarEntry(d.getDn());
+                forEachAttrIntern(d, &r.getOpts(), true, [&] (const char* attr, QoreValue v) {
+                    r.addColumnarValue(attr, v);
+                }, xsink, &r.bytes, &r.getInternTable());
+                r.endColumnarEntry();
+                break;
+            }
+        }
+        return *xsink ? -1 : 0;
+    }
+
+    // returns a hash with "dn" and "attributes" keys for the given search result entry
+    DLLLOCAL QoreHashNode* makeEntryIntern(LDAPMessage* e, ExceptionSink* xsink, const QoreLdapResultOpts* ropts = nullptr, bool always_list = false, size_t* bytes = nullptr, QoreLdapInternTable* it = nullptr) {
+        QoreLdapEntryDecoder d(ldp, e);
+        if (bytes)
+            *bytes += d.getDn().bv_len;
+        return makeEntryIntern(d, xsink, ropts, always_list, bytes, it);
+    }
+
+    DLLLOCAL QoreHashNode* makeEntryIntern(QoreLdapEntryDecoder& d, ExceptionSink* xsink, const QoreLdapResultOpts* ropts = nullptr, bool always_list = false, size_t* bytes = nullptr, QoreLdapInternTable* it = nullptr) {
+        ReferenceHolder<QoreHashNode> attrs(getEntryAttrsIntern(d, xsink, ropts, always_list, bytes, it), xsink);
+        if (!attrs)
+            return 0;
+
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+        const berval& dn = d.getDn();
+        h->setKeyValue("dn", new QoreStringNode(dn.bv_val, dn.bv_len, QCS_UTF8), xsink);
+        h->setKeyValue("attributes", attrs.release(), xsink);
+        return h.release();
+    }
+
+    // discards all pending operations; the lock must be held
+    DLLLOCAL void clearPendingIntern() {
+        for (auto& i : pending)
+            delete i.second;
+        pending.clear();
+        for (auto& i : orphans)
+            delete i.second;
+        orphans.clear();
+    }
+
+    // fails all pending operations because the session context is reinitialized; the lock must be held
+    /** asynchronous operations are kept with the \c LDAP_SERVER_DOWN error until they are retrieved or abandoned,
+        while the requests of searches whose entries are retrieved one at a time are discarded
+    */
+    DLLLOCAL void orphanPendingIntern() {
+        failPendingIntern(LDAP_SERVER_DOWN);
+        for (auto& i : pending) {
+            if (i.second->async)
+                orphans[getHandleIntern(i.first)] = i.second;
+            else
+                delete i.second;
+        }
+        pending.clear();
+        ++ctx_gen;
+    }
+
+    // returns the handle of the asynchronous operation with the given message ID in the current session context
+    DLLLOCAL int64 getHandleIntern(int msgid) const {
+        return ((int64)ctx_gen << 32) | (unsigned)msgid;
+    }
+
+    // returns the message ID of the operation with the given handle if it's in the current session context,
+    // otherwise -1
+    DLLLOCAL int getMsgidIntern(int64 handle) const {
+        return (handle >> 32) == (int64)ctx_gen ? (int)(handle & 0xffffffff) : -1;
+    }
+
+    // removes the asynchronous operation with the given handle; the lock must be held
+    DLLLOCAL void removeAsyncOpIntern(int64 handle) {
+        int msgid = getMsgidIntern(handle);
+        if (msgid != -1) {
+            removeOpIntern(msgid);
+            return;
+        }
+        ldap_orphan_map_t::iterator i = orphans.find(handle);
+        assert(i != orphans.end());
+        delete i->second;
+        orphans.erase(i);
+    }
+
+    // returns true if the current request of the given stream is still pending; the lock must be held
+    DLLLOCAL bool hasStreamOpIntern(const QoreLdapSearchStream& ss) const {
+        return ss.msgid != -1 && ss.gen == ctx_gen && pending.find(ss.msgid) != pending.end();
+    }
+
+    // closes the connection and initializes a new session; if \a probe is false, then the connection is not made
+    // until the next request is sent
+    DLLLOCAL int unbindIntern(ExceptionSink* xsink, int my_timeout_ms = 0, bool probe = true) {
+        // pending operations cannot complete on the new session; asynchronous operations fail when retrieved
+        orphanPendingIntern();
+        schema_types.reset();
+
+        if (ldp) {
+            ldap_unbind_ext_s(ldp, 0, 0);
+            ldp = 0;
+        }
+
+        restore_bind = false;
+        if (initIntern(xsink, "bind", my_timeout_ms, probe))
+            return -1;
+        lazy = false;
+        return 0;
+    }
+
+    // makes the connection for a session whose connection was deferred and binds it with the saved bind
+    // parameters, if any; the lock must be held
+    /** if the connection fails, then it's tried again when the next request is sent
+    */
+    DLLLOCAL int connectIntern(const char* meth, ExceptionSink* xsink, int my_timeout_ms = 0) {
+        assert(lazy && !ldp);
+        if (!my_timeout_ms)
+            my_timeout_ms = timeout_ms;
+        // the bind makes the connection if there are bind parameters
+        if (initIntern(xsink, meth, my_timeout_ms, !bh) || (bh && bindSavedIntern(xsink, meth, my_timeout_ms))) {
+            if (ldp) {
+                ldap_unbind_ext_s(ldp, 0, 0);
+                ldp = 0;
+            }
+            return -1;
+        }
+        lazy = false;
+        return 0;
+    }
+
+    // binds the session with the saved bind parameters
+    DLLLOCAL int bindSavedIntern(ExceptionSink* xsink, const char* meth, int my_timeout_ms = 0) {
+        assert(bh);
+        // the saved bind parameters are replaced by the bind
+        ReferenceHolder<QoreHashNode> h(bh->hashRefSelf(), xsink);
+        return bindInitIntern(xsink, meth, **h, my_timeout_ms);
+    }
+
+    DLLLOCAL int initIntern(ExceptionSink* xsink, const char* m, const QoreStringNode& uristr) {
+        assert(!ldp);
+        assert(!uri);
+        uri = uristr.stringRefSelf();
+        return initIntern(xsink, m);
+    }
+
+    // initializes the session; if there are multiple servers, then they are tried in order of preference until a
+    // connection can be made
+    DLLLOCAL int initIntern(ExceptionSink* xsink, const char* m, int my_timeout_ms = 0, bool probe = true) {
+        if (!servers)
+            return initServerIntern(xsink, m, my_timeout_ms, probe);
+
+        // the errors of all servers tried
+        QoreString errs;
+        std::vector<unsigned> order = servers->getOrder();
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (uri)
+                uri->deref();
+            uri = new QoreStringNode(servers->getUri(order[i]));
+            server_idx = order[i];
+            // each attempt has its own exception sink so that the error of every server can be reported
+            ExceptionSink xsink2;
+            // a connection is always made to find a server that is up
+            if (!initServerIntern(&xsink2, m, my_timeout_ms, true)) {
+                servers->connected(order[i]);
+                return 0;
+            }
+            servers->failure(order[i]);
+            {
+                QoreStringValueHelper err(xsink2.getExceptionErr());
+                QoreStringValueHelper desc(xsink2.getExceptionDesc());
+                errs.sprintf("%s'%s': %s: %s", errs.empty() ? "" : "; ", uri->c_str(), err->c_str(), desc->c_str());
+            }
+            xsink2.clear();
+            if (i == order.size() - 1)
+                break;
+            // discard the session and try the next server
+            if (ldp) {
+                ldap_unbind_ext_s(ldp, 0, 0);
+                ldp = 0;
+            }
+        }
+        xsink->raiseException("LDAP-ERROR", "LdapClient::%s(): cannot connect to any of the %d configured server(s): %s", m, (int)order.size(), errs.c_str());
+        return -1;
+    }
+
+    // initializes the session for the current URI
+    DLLLOCAL int initServerIntern(ExceptionSink* xsink, const char* m, int my_timeout_ms = 0, bool probe = true) {
+        if (checkLdapError(m, "ldap_initialize", ldap_initialize(&ldp, uri->getBuffer()), xsink))
+            return -1;
+
+        // set protocol version
+        if (ldap_set_option(ldp, LDAP_OPT_PROTOCOL_VERSION, &prot)) {
+            xsink->raiseException("LDAP-ERROR", "failed to set LDAP protocol v%d; ldap_set_option(LDAP_OPT_PROTOCOL_VERSION) failed", prot);
+            return -1;
+        }
+
+        // set restart option
+        if (ldap_set_option(ldp, LDAP_OPT_RESTART, LDAP_OPT_ON)) {
+            xsink->raiseException("LDAP-ERROR", "failed to set LDAP restart option; ldap_set_option(LDAP_OPT_RESTART) failed");
+            return -1;
+        }
+
+        // set timeout
+        TimeoutHelper timeout(timeout_ms);
+
+        if (ldap_set_option(ldp, LDAP_OPT_TIMEOUT, &timeout)) {
+            xsink->raiseException("LDAP-ERROR", "failed to set default LDAP timeout to %d ms; ldap_set_option(LDAP_OPT_TIMEOUT) failed", timeout_ms);
+            return -1;
+        }
+
+        // disable referrals if necessary
+        if (no_referrals && ldap_set_option(ldp, LDAP_OPT_REFERRALS, LDAP_OPT_OFF)) {
+            xsink->raiseException("LDAP-ERROR", "failed to disable LDAP referrals; ldap_set_option(LDAP_OPT_REFERRALS) failed");
+            return -1;
+        }
+
+        if (my_timeout_ms && my_timeout_ms != timeout_ms)
+            timeout = my_timeout_ms;
+
+        // force a connection to the server with an empty search request and ignore the result
+        if (probe) {
+            int msgid;
+            if (checkLdapError(m, "ldap_search_ext", ldap_search_ext(ldp, 0, LDAP_SCOPE_BASE, 0, 0, 0, 0, 0, 0, 0, &msgid), xsink))
+                return -1;
+            LDAPMessage* res = 0;
+            if (checkLdapResult(m, "ldap_search_ext", ldap_result(ldp, msgid, LDAP_MSG_ALL, &timeout, &res), xsink)) {
+                assert(!res);
+                return -1;
+            }
+            ldap_msgfree(res);
+        }
+
+        // issue a STARTTLS if necessary
+        if (tls && !ldap_tls_inplace(ldp)) {
+            if (checkLdapError("constructor", "ldap_start_tls_s", ldap_start_tls_s(ldp, 0, 0), xsink))
+                return -1;
+            //printd(0, "QoreLdapClient::initIntern() STARTTLS successful\n");
+        }
+
+        return 0;
+    }
+
+    // binds the session; if \a t is 0, then the bind is timed and recorded in the statistics here
+    DLLLOCAL int bindInitIntern(ExceptionSink* xsink, const char* m, const QoreHashNode& bindh, int my_timeout_ms = 0, QoreLdapOpTimer* t = nullptr) {
+        assert(ldp);
+
+        const QoreStringNode* password = check_hash_key<QoreStringNode>(xsink, bindh, "password", "LDAP-BIND-ERROR");
+
+        const QoreStringNode* binddn = check_hash_key<QoreStringNode>(xsink, bindh, "binddn", "LDAP-BIND-ERROR");
+        if (!binddn) {
+            if (password && !password->empty())
+                xsink->raiseException("LDAP-BIND-ERROR", "password given but no bind DN given for bind");
+            return -1;
+        }
+
+        QoreLdapOpTimer lt(stats, xsink, t ? QLS_NONE : QLS_BIND);
+        if (!t)
+            t = &lt;
+        t->dn = binddn;
+
+        QoreStringValueHelper bstr(binddn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        QoreStringBervalHelper passwd(password, xsink);
+        if (*xsink)
+            return -1;
+
+        LDAPMessage* result = sendBindIntern(xsink, m, bstr->getBuffer(), passwd, my_timeout_ms, *t);
+        if (!result)
+            return -1;
+
+        if (slow_cb) {
+            int err;
+            if (ldap_parse_result(ldp, result, &err, 0, 0, 0, 0, 0) == LDAP_SUCCESS)
+                t->result = err;
+        }
+
+        if (checkFreeResult(m, "ldap_sasl_bind", result, xsink))
+            return -1;
+
+        // save the bind parameters so that new sessions can be bound with the same identity
+        saveBindIntern(binddn, password, xsink);
+        restore_bind = false;
+        return 0;
+    }
+
+    // sends a simple bind request on the current connection and waits for the result; returns the result message,
+    // which must be freed by the caller, or 0 if an exception was raised
+    DLLLOCAL LDAPMessage* sendBindIntern(ExceptionSink* xsink, const char* m, const char* dn, berval& cred, int my_timeout_ms, QoreLdapOpTimer& t) {
+        int msgid;
+
+        int rc = ldap_sasl_bind(ldp, dn, LDAP_SASL_SIMPLE, &cred, 0, 0, &msgid);
+        if (checkLdapError(m, "ldap_sasl_bind", rc, xsink)) {
+            t.result = rc;
+            return 0;
+        }
+        t.msgid = msgid;
+
+        LDAPMessage* result = 0;
+        TimeoutHelper timeout(my_timeout_ms);
+
+        t.phase(QLP_WAIT);
+        rc = ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &result);
+        t.phase(QLP_DECODE);
+        if (checkLdapResult(m, "ldap_sasl_bind", rc, xsink)) {
+            assert(!result);
+            t.result = rc ? rc : LDAP_TIMEOUT;
+            return 0;
+        }
+        return result;
+    }
+
+    // restores the saved identity of the session after credentials were verified with checkBind(); the lock must
+    // be held
+    DLLLOCAL int restoreBindIntern(const char* meth, ExceptionSink* xsink) {
+        assert(restore_bind);
+        if (bh) {
+            if (bindSavedIntern(xsink, meth, timeout_ms))
+                return -1;
+        }
+        else {
+            // the session was not bound; return to an anonymous bind
+            berval cred = {0, 0};
+            QoreLdapOpTimer t(stats, xsink);
+            LDAPMessage* result = sendBindIntern(xsink, meth, "", cred, timeout_ms, t);
+            if (!result || checkFreeResult(meth, "ldap_sasl_bind", result, xsink))
+                return -1;
+        }
+        restore_bind = false;
+        return 0;
+    }
+
+    // verifies the given credentials with a simple bind on the current connection; returns 1 if the credentials are
+    // valid, 0 if not, or -1 if an exception was raised; the write lock and the lock must be held
+    DLLLOCAL int checkBindIntern(ExceptionSink* xsink, const QoreStringNode* binddn, const QoreStringNode* password, int my_timeout_ms, QoreLdapOpTimer& t) {
+        if (checkValidIntern("checkBind", xsink))
+            return -1;
+        // a bind must not be sent while other operations are outstanding on the connection
+        if (!pending.empty()) {
+            xsink->raiseException("LDAP-BIND-ERROR", "cannot execute LdapClient::checkBind() while %d asynchronous operation(s) are outstanding on the session", (int)pending.size());
+            return -1;
+        }
+
+        QoreStringValueHelper bstr(binddn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+        QoreStringBervalHelper passwd(password, xsink);
+        if (*xsink)
+            return -1;
+        // a bind without a password is an unauthenticated bind, which servers can accept for any DN
+        if (!passwd.bv_len || bstr->empty())
+            return 0;
+
+        if (!my_timeout_ms)
+            my_timeout_ms = timeout_ms;
+
+        if (lazy) {
+            // the session is only connected; the saved identity is restored with the next request
+            if (initIntern(xsink, "checkBind", my_timeout_ms, false)) {
+                if (ldp) {
+                    ldap_unbind_ext_s(ldp, 0, 0);
+                    ldp = 0;
+                }
+                return -1;
+            }
+            lazy = false;
+        }
+
+        // the session no longer has its saved identity once the bind has been sent
+        restore_bind = true;
+        LDAPMessage* result = sendBindIntern(xsink, "checkBind", bstr->c_str(), passwd, my_timeout_ms, t);
+        if (!result)
+            return -1;
+
+        QoreLdapParseResultHelper prh("checkBind", "ldap_sasl_bind", this, result, xsink);
+        if (*xsink)
+            return -1;
+        t.result = prh.getError();
+        if (t.result == LDAP_INVALID_CREDENTIALS)
+            return 0;
+        return prh.check() ? -1 : 1;
+    }
+
+    DLLLOCAL void saveBindIntern(const QoreStringNode* binddn, const QoreStringNode* password, ExceptionSink* xsink) {
+        ReferenceHolder<QoreHashNode> nbh(new QoreHashNode, xsink);
+        nbh->setKeyValue("binddn", binddn->refSelf(), xsink);
+        if (password)
+            nbh->setKeyValue("password", password->refSelf(), xsink);
+        if (bh)
+            bh->deref(xsink);
+        bh = nbh.release();
+    }
+
+    // saves the bind parameters in the given hash for a deferred connection; returns -1 if an exception was raised
+    DLLLOCAL int saveBindIntern(const QoreHashNode& bindh, ExceptionSink* xsink) {
+        const QoreStringNode* password = check_hash_key<QoreStringNode>(xsink, bindh, "password", "LDAP-BIND-ERROR");
+        const QoreStringNode* binddn = check_hash_key<QoreStringNode>(xsink, bindh, "binddn", "LDAP-BIND-ERROR");
+        if (*xsink)
+            return -1;
+        if (!binddn) {
+            if (password && !password->empty()) {
+                xsink->raiseException("LDAP-BIND-ERROR", "password given but no bind DN given for bind");
+                return -1;
+            }
+            return 0;
+        }
+        saveBindIntern(binddn, password, xsink);
+        return 0;
+    }
+
+    // the following functions convert the request arguments, lock the session with the helper, and send the
+    // request; they return the message ID or -1 if an exception was raised
+
+    // \a ctrl is an optional additional server control to send with the request
+    DLLLOCAL int searchStart(OpHelper& oh, const QoreLdapSearchParams& sp, ExceptionSink* xsink, const berval* cookie = nullptr, LDAPControl* ctrl = nullptr) {
+        // convert strings to UTF-8 if necessary
+        QoreStringValueHelper bstr(sp.base, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        QoreStringValueHelper fstr(sp.filter, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        // get attribute list
+        AttrListHelper attrs(*sp.attrl, xsink);
+        if (*xsink)
+            return -1;
+
+        if (oh.lock())
+            return -1;
+
+        QoreLdapControlList ctrls;
+
+        // add the simple paged results control if necessary
+        if (sp.page_size) {
+            LDAPControl* page_ctrl;
+            berval empty = {0, 0};
+            if (checkLdapError("search", "ldap_create_page_control", ldap_create_page_control(ldp, sp.page_size, cookie ? (berval*)cookie : &empty, 0, &page_ctrl), xsink))
+                return -1;
+            ctrls.add(page_ctrl);
+        }
+
+        // add the server-side sort control; it's critical so that results are never returned unsorted
+        if (sp.sort_keys) {
+            LDAPControl* sort_ctrl;
+            if (checkLdapError("search", "ldap_create_sort_control", ldap_create_sort_control(ldp, sp.sort_keys, 1, &sort_ctrl), xsink))
+                return -1;
+            ctrls.add(sort_ctrl);
+        }
+
+        // add the virtual list view control
+        if (sp.vlv) {
+            berval value = {(ber_len_t)sp.vlv_value.size(), (char*)sp.vlv_value.data()};
+            berval context = {(ber_len_t)sp.vlv_context.size(), (char*)sp.vlv_context.data()};
+            LDAPVLVInfo vi;
+            vi.ldvlv_version = 1;
+            vi.ldvlv_before_count = sp.vlv_before;
+            vi.ldvlv_after_count = sp.vlv_after;
+            vi.ldvlv_offset = sp.vlv_offset;
+            vi.ldvlv_count = sp.vlv_count;
+            vi.ldvlv_attrvalue = sp.vlv_by_value ? &value : nullptr;
+            vi.ldvlv_context = sp.vlv_has_context ? &context : nullptr;
+            vi.ldvlv_extradata = nullptr;
+
+            LDAPControl* vlv_ctrl;
+            if (checkLdapError("search", "ldap_create_vlv_control", ldap_create_vlv_control(ldp, &vi, &vlv_ctrl), xsink))
+                return -1;
+            ctrls.add(vlv_ctrl);
+        }
+
+        if (ctrl)
+            ctrls.add(ctrl, false);
+
+        int msgid;
+        int rc = ldap_search_ext(ldp, bstr->empty() ? 0 : bstr->getBuffer(), sp.scope, fstr->empty() ? 0 : fstr->getBuffer(), *attrs, (int)sp.attrsonly, ctrls.get(), 0, 0, 0, &msgid);
+        if (checkLdapError("search", "ldap_search_ext", rc, xsink))
+            return -1;
+        return msgid;
+    }
+
+    // returns the parent DN of the given DN or 0 if it has no parent
+    DLLLOCAL static const char* getParentDn(const char* dn) {
+        for (const char* p = dn; *p; ++p) {
+            if (*p == '\\' && p[1])
+                ++p;
+            else if (*p == ',')
+                return p + 1;
+        }
+        return 0;
+    }
+
+    DLLLOCAL int addStart(OpHelper& oh, const QoreStringNode* dn, const QoreHashNode* attr, ExceptionSink* xsink) {
+        // convert strings to UTF-8 if necessary
+        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        ModListHelper mods(xsink, attr);
+        if (*xsink)
+            return -1;
+
+        if (oh.lock())
+            return -1;
+
+        oh.invalidate(dnstr->c_str());
+        int msgid;
+        if (checkLdapError("add", "ldap_add_ext", ldap_add_ext(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), *mods, 0, 0, &msgid), xsink))
+            return -1;
+        return msgid;
+    }
+
+    DLLLOCAL int modifyStart(OpHelper& oh, const QoreStringNode* dn, const QoreListNode* ml, ExceptionSink* xsink) {
+        // convert strings to UTF-8 if necessary
+        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        ModListHelper mods(xsink, ml);
+        if (*xsink)
+            return -1;
+
+        if (oh.lock())
+            return -1;
+
+        oh.invalidate(dnstr->c_str());
+        int msgid;
+        if (checkLdapError("modify", "ldap_modify_ext", ldap_modify_ext(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), *mods, 0, 0, &msgid), xsink))
+            return -1;
+        return msgid;
+    }
+
+    DLLLOCAL int delStart(OpHelper& oh, const QoreStringNode* dn, ExceptionSink* xsink) {
+        // convert strings to UTF-8 if necessary
+        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        if (oh.lock())
+            return -1;
+
+        oh.invalidate(dnstr->c_str());
+        int msgid;
+        if (checkLdapError("del", "ldap_delete_ext", ldap_delete_ext(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), 0, 0, &msgid), xsink))
+            return -1;
+        return msgid;
+    }
+
+    DLLLOCAL int compareStart(OpHelper& oh, const QoreStringNode* dn, const QoreStringNode* attr, const QoreListNode* vl, ExceptionSink* xsink) {
+        // convert strings to UTF-8 if necessary
+        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        QoreStringValueHelper attrstr(attr, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        BervalListHelper bval(vl, xsink);
+        if (*xsink)
+            return -1;
+
+        if (oh.lock())
+            return -1;
+
+        int msgid;
+        if (checkLdapError("compare", "ldap_compare_ext", ldap_compare_ext(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), attrstr->empty() ? 0 : attrstr->getBuffer(), **bval, 0, 0, &msgid), xsink))
+            return -1;
+        return msgid;
+    }
+
+    DLLLOCAL int renameStart(OpHelper& oh, const QoreStringNode* dn, const QoreStringNode* newrdn, const QoreStringNode* newparent, bool deleteoldrdn, ExceptionSink* xsink) {
+        // convert strings to UTF-8 if necessary
+        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        QoreStringValueHelper newrdnstr(newrdn, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        QoreStringValueHelper newparentstr(newparent, QCS_UTF8, xsink);
+        if (*xsink)
+            return -1;
+
+        if (oh.lock())
+            return -1;
+
+        //printd(5, "LdapClient::rename() dn: '%s' newrdn: '%s' newparent: '%s' deleteoldrdn: %d\n", dnstr->getBuffer(), newrdnstr->getBuffer(), newparentstr->getBuffer(), (int)deleteoldrdn);
+
+        if (cache) {
+            oh.invalidate(dnstr->c_str());
+            std::string newdn = newrdnstr->c_str();
+            const char* parent = newparentstr->empty() ? getParentDn(dnstr->c_str()) : newparentstr->c_str();
+            if (parent && *parent) {
+                newdn += ',';
+                newdn += parent;
+            }
+            oh.invalidate(newdn.c_str());
+        }
+
+        int msgid;
+        if (checkLdapError("rename", "ldap_rename", ldap_rename(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), newrdnstr->empty() ? 0 : newrdnstr->getBuffer(), newparentstr->empty() ? 0 : newparentstr->getBuffer(), (int)deleteoldrdn, 0, 0, &msgid), xsink))
+            return -1;
+        return msgid;
+    }
+
+    DLLLOCAL int passwdStart(OpHelper& oh, const QoreStringNode* dn, const QoreStringNode* op, const QoreStringNode* np, ExceptionSink* xsink) {
+        // convert strings to UTF-8 if necessary
+        QoreStringBervalHelper dnstr(dn, xsink);
+        if (*xsink)
+            return -1;
+
+        QoreStringBervalHelper opstr(op, xsink);
+        if (*xsink)
+            return -1;
+
+        QoreStringBervalHelper npstr(np, xsink);
+        if (*xsink)
+            return -1;
+
+        if (oh.lock())
+            return -1;
+
+        //printd(5, "LdapClient::passwd() dn: '%s' old: '%s' new: '%s'\n", dnstr->getBuffer(), opstr->getBuffer(), npstr->getBuffer());
+
+        int msgid;
+        if (checkLdapError("passwd", "ldap_passwd", ldap_passwd(ldp, &dnstr, &opstr, &npstr, 0, 0, &msgid), xsink))
+            return -1;
+        return msgid;
+    }
+
+    // reads the entry given as the search base with a search with the base scope
+    DLLLOCAL QoreValue searchEntry(ExceptionSink* xsink, const QoreHashNode& h, int my_timeout_ms) {
+        QoreLdapSearchParams sp(xsink);
+        if (sp.parse(h))
+            return QoreValue();
+        sp.scope = LDAP_SCOPE_BASE;
+        return retryIntern(xsink, true, [&] () { return searchIntern(xsink, sp, my_timeout_ms); });
+    }
+
+public:
+    // \a srv is the server set shared by the sessions in a pool, if any; if \a defer_connect is true, then the
+    // connection is not made regardless of the lazy_connect option
+    DLLLOCAL QoreLdapClient(const QoreStringNode* uristr, const QoreHashNode* opth, ExceptionSink* xsink, std::shared_ptr<QoreLdapServerSet> srv = std::shared_ptr<QoreLdapServerSet>(), bool defer_connect = false) : ldp(0), uri(0), bh(0), prot(QORE_LDAP_DEFAULT_PROTOCOL), timeout_ms(QORE_LDAP_DEFAULT_TIMEOUT_MS), multiplex(opth ? opth->getKeyValue("multiplex").getAsBool() : false), tls(false), no_referrals(false), reading(false), reconnect(false), lazy(false), fast_bind(false), restore_bind(false) {
+        //printd(5, "QoreLdapClient::QoreLdapClient() this: %p uri: '%s' opth: %p\n", this, uristr->getBuffer(), opth);
+
+        if (opth) {
+            QoreValue p = opth->getKeyValue("protocol");
+            int i = p.getAsBigInt();
+            if (i)
+                prot = i;
+
+            i = getMsZeroInt(opth->getKeyValue("timeout"));
+            if (i)
+                timeout_ms = i;
+
+            //printd(0, "QoreLdapClient::QoreLdapClient() set default timeout to %d ms\n", timeout_ms);
+
+            p = opth->getKeyValue("no-referrals");
+            bool refp = p.getAsBool();
+            if (refp)
+                no_referrals = true;
+
+            p = opth->getKeyValue("starttls");
+            tls = p.getAsBool();
+
+            p = opth->getKeyValue("lazy_connect");
+            lazy = p.getAsBool();
+
+            p = opth->getKeyValue("fast_bind");
+            fast_bind = p.getAsBool();
+
+            p = opth->getKeyValue("reconnect");
+            reconnect = p.getAsBool();
+
+            p = opth->getKeyValue("max_retries");
+            if (!p.isNothing()) {
+                max_retries = (int)p.getAsBigInt();
+                if (max_retries < 0) {
+                    xsink->raiseException("LDAP-OPTION-ERROR", "the 'max_retries' option must not be negative; got %d", max_retries);
+                    return;
+                }
+            }
+
+            p = opth->getKeyValue("retry_delay");
+            if (!p.isNothing())
+                retry_delay_ms = getMsZeroInt(p);
+
+            cache = QoreLdapSearchCache::create(opth, xsink);
+            if (*xsink)
+                return;
+
+            slow_us = (int64)getMsZeroInt(opth->getKeyValue("slow_threshold")) * 1000;
+            p = opth->getKeyValue("slow_callback");
+            if (!p.isNothing()) {
+                if (p.getType() != NT_FUNCREF && p.getType() != NT_RUNTIME_CLOSURE) {
+                    xsink->raiseException("LDAP-OPTION-ERROR", "the 'slow_callback' option must be a closure or call reference; got type '%s' instead", p.getFullTypeName());
+                    return;
+                }
+                slow_cb = p.get<ResolvedCallReferenceNode>()->refRefSelf();
+            }
+        }
+
+        servers = srv ? srv : QoreLdapServerSet::create(*uristr, opth, xsink);
+        if (*xsink)
+            return;
+
+        if (defer_connect)
+            lazy = true;
+        if (lazy) {
+            // the session is connected and bound when the first request is sent
+            uri = uristr->stringRefSelf();
+            if (opth)
+                saveBindIntern(*opth, xsink);
+            return;
+        }
+
+        if (initIntern(xsink, "constructor", *uristr))
+            return;
+
+        if (opth) {
+            bindInitIntern(xsink, "constructor", *opth);
+            if (*xsink)
+                return;
+        }
+    }
+
+    DLLLOCAL QoreLdapClient(const QoreLdapClient& old, ExceptionSink* xsink) : ldp(0), uri(0), bh(0), prot(old.prot), timeout_ms(old.timeout_ms), multiplex(old.multiplex), tls(old.tls), no_referrals(old.no_referrals), reading(false), reconnect(old.reconnect), lazy(false), fast_bind(old.fast_bind), restore_bind(false) {
+        AutoLocker al(old.m);
+        // the copy gets a new empty cache with the same configuration
+        if (old.cache)
+            cache = old.cache->copy();
+        if (old.slow_cb) {
+            slow_cb = old.slow_cb->refRefSelf();
+            slow_us = old.slow_us;
+        }
+        max_retries = old.max_retries;
+        retry_delay_ms = old.retry_delay_ms;
+        servers = old.servers;
+
+        if (old.checkValidIntern("copy", xsink))
+            return;
+
+        // the copy of a session that has not been connected yet is also connected on first use
+        if (old.lazy) {
+            lazy = true;
+            uri = old.uri->stringRefSelf();
+            if (old.bh)
+                bh = old.bh->hashRefSelf();
+            return;
+        }
+
+        if (initIntern(xsink, "copy", *old.uri))
+            return;
+
+        if (old.bh && bindInitIntern(xsink, "copy", *old.bh))
+            return;
+    }
+
+    DLLLOCAL ~QoreLdapClient() {
+        assert(!ldp);
+        assert(!uri);
+        assert(!bh);
+        assert(!slow_cb);
+        assert(pending.empty());
+        assert(orphans.empty());
+    }
+
+    DLLLOCAL int destructor(ExceptionSink* xsink) {
+        // wait for any threads reading responses without the lock to finish
+        QoreAutoRWWriteLocker wl(rwl);
+        AutoLocker al(m);
+        clearPendingIntern();
+
+        if (ldp) {
+            ldap_unbind_ext_s(ldp, 0, 0);
+            ldp = 0;
+        }
+
+        if (uri) {
+            uri->deref();
+            uri = 0;
+        }
+
+        if (bh) {
+            bh->deref(xsink);
+            bh = 0;
+        }
+
+        if (slow_cb) {
+            slow_cb->deref(xsink);
+            slow_cb = nullptr;
+        }
+
+        return 0;
+    }
+
+    DLLLOCAL bool isSecure(ExceptionSink* xsink) {
+        AutoLocker al(m);
+        if (checkValidIntern("isSecure", xsink))
+            return -1;
+        if (lazy && connectIntern("isSecure", xsink))
+            return false;
+
+        return ldap_tls_inplace(ldp);
+    }
+
+    // makes the connection now if it was deferred with the lazy_connect option; returns -1 if an exception was
+    // raised
+    DLLLOCAL int connect(ExceptionSink* xsink, int my_timeout_ms = 0) {
+        AutoLocker al(m);
+        if (checkValidIntern("connect", xsink))
+            return -1;
+        return lazy ? connectIntern("connect", xsink, my_timeout_ms) : 0;
+    }
+
+    // returns true if the connection has been made
+    DLLLOCAL bool isConnected() const {
+        AutoLocker al(m);
+        return ldp && !lazy;
+    }
+
+    DLLLOCAL int bind(ExceptionSink* xsink, const QoreHashNode& bindh, int my_timeout_ms = 0) {
+        QoreLdapOpTimer t(stats, xsink, QLS_BIND, QLP_LOCK);
+        int rc = rebindIntern(xsink, bindh, my_timeout_ms, t);
+        traceDone(t, xsink);
+        return rc;
+    }
+
+    // verifies the given credentials with a bind on the current connection without changing the identity used for
+    // other requests; returns 1 if the credentials are valid, 0 if not, or -1 if an exception was raised
+    DLLLOCAL int checkBind(ExceptionSink* xsink, const QoreStringNode* binddn, const QoreStringNode* password, int my_timeout_ms = 0) {
+        QoreLdapOpTimer t(stats, xsink, QLS_BIND, QLP_LOCK);
+        t.dn = binddn;
+        int rc;
+        {
+            QoreAutoRWWriteLocker wl(rwl);
+            AutoLocker al(m);
+            t.phase(QLP_SEND);
+            rc = checkBindIntern(xsink, binddn, password, my_timeout_ms, t);
+        }
+        traceDone(t, xsink);
+        return rc;
+    }
+
+protected:
+    // rebinds the session with the given bind parameters
+    DLLLOCAL int rebindIntern(ExceptionSink* xsink, const QoreHashNode& bindh, int my_timeout_ms, QoreLdapOpTimer& t) {
+        QoreAutoRWWriteLocker wl(rwl);
+        AutoLocker al(m);
+        t.phase(QLP_SEND);
+        if (checkValidIntern("bind", xsink))
+            return -1;
+
+        // cached results could differ for the new identity
+        if (cache)
+            cache->clear();
+
+        // rebind on the current connection if possible; a bind must not be sent while other operations are
+        // outstanding, and an anonymous bind always gets a new connection
+        if (fast_bind && ldp && !lazy && pending.empty() && bindh.getKeyValue("binddn").getType() == NT_STRING) {
+            if (!bindInitIntern(xsink, "bind", bindh, my_timeout_ms, &t))
+                return 0;
+            // make a new connection if the connection was lost
+            if (t.result != LDAP_SERVER_DOWN && t.result != LDAP_CONNECT_ERROR)
+                return -1;
+            xsink->clear();
+            t.result = 0;
+        }
+
+        // the bind makes the connection
+        if (unbindIntern(xsink, my_timeout_ms, false))
+            return -1;
+
+        return bindInitIntern(xsink, "bind", bindh, my_timeout_ms, &t);
+    }
+
+    // returns true if the connection was lost since the given connection generation
+    /** also returns true if the session has already been reconnected by another thread
+    */
+    DLLLOCAL bool isConnectionLost(unsigned gen) {
+        AutoLocker al(m);
+        if (gen != conn_gen)
+            return true;
+        return isConnectionDownIntern();
+    }
+
+    // returns the current connection generation
+    DLLLOCAL unsigned getConnGen() const {
+        AutoLocker al(m);
+        return conn_gen;
+    }
+
+    // reconnects and rebinds the session with the saved URI and bind parameters unless it has already been
+    // reconnected since the given connection generation; returns -1 if an exception was raised
+    DLLLOCAL int reconnectIntern(ExceptionSink* xsink, unsigned gen) {
+        // wait for any threads reading responses without the lock to finish
+        QoreAutoRWWriteLocker wl(rwl);
+        AutoLocker al(m);
+        if (gen != conn_gen)
+            return 0;
+        if (checkValidIntern("reconnect", xsink))
+            return -1;
+
+        // the connection is made by the bind or by the next request
+        if (unbindIntern(xsink, 0, false))
+            return -1;
+        if (bh && bindSavedIntern(xsink, "reconnect"))
+            return -1;
+        ++conn_gen;
+        return 0;
+    }
+
+    // executes the given operation; if the connection is lost and the \c reconnect option is set, then the session
+    // is reconnected, and idempotent operations are retried with exponential backoff
+    /** non-idempotent operations are not retried, because they could have been executed by the server before the
+        connection was lost
+    */
+    template <typename F>
+    DLLLOCAL auto retryIntern(ExceptionSink* xsink, bool idempotent, F f) -> decltype(f()) {
+        unsigned gen = getConnGen();
+        auto rv = f();
+        if (!reconnect || !*xsink || !isConnectionLost(gen))
+            return rv;
+
+        if (!idempotent) {
+            // reconnect for subsequent requests; the original exception is raised in any case
+            ExceptionSink xsink2;
+            reconnectIntern(&xsink2, gen);
+            xsink2.clear();
+            return rv;
+        }
+
+        int64 delay_us = (int64)retry_delay_ms * 1000;
+        for (int i = 0; i < max_retries; ++i, delay_us *= 2) {
+            // wait a random time between half and the full delay so that clients do not reconnect all at once
+            if (delay_us > 0)
+                qore_usleep(delay_us / 2 + (int64)(((unsigned long long)q_clock_getmicros() ^ ((unsigned long long)q_gettid() * 2654435761ULL)) % (unsigned long long)(delay_us / 2 + 1)));
+
+            ExceptionSink xsink2;
+            if (reconnectIntern(&xsink2, gen)) {
+                xsink2.clear();
+                continue;
+            }
+
+            xsink->clear();
+            gen = getConnGen();
+            rv = f();
+            if (!*xsink || !isConnectionLost(gen))
+                break;
+        }
+        return rv;
+    }
+
+    // records the given operation in the statistics and calls the slow operation callback if the operation took at
+    // least as long as the threshold; must be called without the lock held
+    DLLLOCAL void traceDone(QoreLdapOpTimer& t, ExceptionSink* xsink) {
+        if (!t.done())
+            return;
+
+        trackServer(t, xsink);
+
+        if (!slow_cb || t.getTotal() < slow_us)
+            return;
+
+        QoreHashNode* trace;
+        {
+            AutoLocker al(m);
+            // the object has been destroyed
+            if (!slow_cb)
+                return;
+            trace = makeTraceIntern(t, xsink);
+        }
+        callSlowCallback(trace, xsink);
+    }
+
+    // records the given operation in the statistics; the lock must be held
+    /** @return the trace for the slow operation callback if the operation took at least as long as the threshold,
+        which must be passed to callSlowCallback() or OpHelper::addTrace() by the caller, otherwise 0
+    */
+    DLLLOCAL QoreHashNode* traceDoneIntern(QoreLdapOpTimer& t, ExceptionSink* xsink) {
+        if (!t.done())
+            return nullptr;
+
+        trackServer(t, xsink);
+
+        if (!slow_cb || t.getTotal() < slow_us)
+            return nullptr;
+        return makeTraceIntern(t, xsink);
+    }
+
+    // updates the state of the server the session is connected to with the outcome of the given operation
+    DLLLOCAL void trackServer(const QoreLdapOpTimer& t, ExceptionSink* xsink) {
+        if (!servers)
+            return;
+        int idx = server_idx;
+        if (idx >= 0) {
+            if (t.result == LDAP_SERVER_DOWN || t.result == LDAP_CONNECT_ERROR || t.result == LDAP_TIMEOUT)
+                servers->failure(idx);
+            // only operations that received a response are used for response times
+            else if (t.msgid >= 0 && (!*xsink || t.result))
+                servers->success(idx, t.getTime(QLP_WAIT));
+        }
+    }
+
+    // returns the argument for the slow operation callback for the given operation; the lock must be held
+    DLLLOCAL QoreHashNode* makeTraceIntern(const QoreLdapOpTimer& t, ExceptionSink* xsink) const {
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+        if (uri)
+            h->setKeyValue("uri", uri->stringRefSelf(), xsink);
+        h->setKeyValue("op", new QoreStringNode(QoreLdapStats::getOpName(t.getOp())), xsink);
+        if (t.dn)
+            h->setKeyValue("dn", t.dn->stringRefSelf(), xsink);
+        if (t.base)
+            h->setKeyValue("base", t.base->stringRefSelf(), xsink);
+        if (t.filter)
+            h->setKeyValue("filter", t.filter->stringRefSelf(), xsink);
+        h->setKeyValue("msgid", t.msgid, xsink);
+        for (unsigned i = 0; i < QLP_NUM; ++i) {
+            QoreStringMaker key("%s_us", QoreLdapStats::getPhaseName((qore_ldap_phase_e)i));
+            h->setKeyValue(key.c_str(), t.getTime((qore_ldap_phase_e)i), xsink);
+        }
+        h->setKeyValue("total_us", t.getTotal(), xsink);
+        h->setKeyValue("result", t.result, xsink);
+        h->setKeyValue("result_desc", new QoreStringNode(ldap_err2string(t.result)), xsink);
+        h->setKeyValue("error", t.isError(), xsink);
+        return h.release();
+    }
+
+    // calls the slow operation callback with the given trace and releases it; must be called without the lock held
+    DLLLOCAL void callSlowCallback(QoreHashNode* trace, ExceptionSink* xsink) {
+        ReferenceHolder<QoreHashNode> h(trace, xsink);
+        ReferenceHolder<ResolvedCallReferenceNode> cb(xsink);
+        {
+            AutoLocker al(m);
+            // the object has been destroyed
+            if (!slow_cb)
+                return;
+            cb = slow_cb->refRefSelf();
+        }
+
+        ReferenceHolder<QoreListNode> args(new QoreListNode(autoTypeInfo), xsink);
+        args->push(h.release(), xsink);
+        // the callback is also called for operations that raised an exception
+        ExceptionSink xsink2;
+        {
+            ValueHolder rv(cb->execValue(*args, &xsink2), &xsink2);
+        }
+        if (xsink2)
+            xsink->assimilate(xsink2);
+    }
+
+public:
+    // returns the attribute value types from the server's schema; the schema is retrieved once per session
+    /** must be called without the lock held
+
+        @return the value type map, which is empty if the server does not publish a schema, or an empty pointer if
+        an exception was raised
+    */
+    DLLLOCAL std::shared_ptr<const ldap_schema_type_map_t> getSchemaTypes(ExceptionSink* xsink, int my_timeout_ms = 0) {
+        {
+            AutoLocker al(m);
+            if (schema_types)
+                return schema_types;
+        }
+
+        std::shared_ptr<ldap_schema_type_map_t> types = std::make_shared<ldap_schema_type_map_t>();
+
+        // get the DN of the subschema subentry from the root DSE
+        ReferenceHolder<QoreHashNode> q(new QoreHashNode, xsink);
+        q->setKeyValue("base", new QoreStringNode, xsink);
+        q->setKeyValue("filter", new QoreStringNode("(objectClass=*)"), xsink);
+        q->setKeyValue("attributes", new QoreStringNode("subschemaSubentry"), xsink);
+        ValueHolder rv(searchEntry(xsink, **q, my_timeout_ms), xsink);
+        if (*xsink)
+            return std::shared_ptr<const ldap_schema_type_map_t>();
+        ReferenceHolder<QoreStringNode> sdn(xsink);
+        if (rv->getType() == NT_HASH) {
+            ConstHashIterator hi(rv->get<const QoreHashNode>());
+            if (hi.next() && hi.get().getType() == NT_HASH) {
+                QoreValue v = getAttrValue(*hi.get().get<const QoreHashNode>(), "subschemaSubentry");
+                if (v.getType() == NT_LIST && !v.get<const QoreListNode>()->empty())
+                    v = v.get<const QoreListNode>()->retrieveEntry(0);
+                if (v.getType() == NT_STRING)
+                    sdn = v.get<const QoreStringNode>()->stringRefSelf();
+            }
+        }
+
+        if (sdn) {
+            q->setKeyValue("base", sdn.release(), xsink);
+            q->setKeyValue("filter", new QoreStringNode("(objectClass=subschema)"), xsink);
+            q->setKeyValue("attributes", new QoreStringNode("attributeTypes"), xsink);
+            ValueHolder srv(searchEntry(xsink, **q, my_timeout_ms), xsink);
+            if (*xsink)
+                return std::shared_ptr<const ldap_schema_type_map_t>();
+            if (srv->getType() == NT_HASH) {
+                ConstHashIterator hi(srv->get<const QoreHashNode>());
+                if (hi.next() && hi.get().getType() == NT_HASH)
+                    addSchemaTypes(*types, getAttrValue(*hi.get().get<const QoreHashNode>(), "attributeTypes"));
+            }
+        }
+
+        AutoLocker al(m);
+        // another thread could have loaded the schema in the meantime
+        if (!schema_types)
+            schema_types = types;
+        return schema_types;
+    }
+
+    // returns the value of the given attribute from an entry hash; attribute names are case-insensitive
+    DLLLOCAL static QoreValue getAttrValue(const QoreHashNode& h, const char* attr) {
+        ConstHashIterator hi(h);
+        while (hi.next()) {
+            if (!strcasecmp(hi.getKey(), attr))
+                return hi.get();
+        }
+        return QoreValue();
+    }
+
+    // adds value types for the given attributeTypes values
+    DLLLOCAL static void addSchemaTypes(ldap_schema_type_map_t& types, QoreValue v) {
+        // map of lower-case attribute names to syntax OIDs and superior types for attributes that inherit their syntax
+        typedef std::map<std::string, std::string> str_map_t;
+        str_map_t syntax, sup;
+
+        auto add = [&] (const QoreStringNode& str) {
+            int code;
+            const char* err;
+            LDAPAttributeType* at = ldap_str2attributetype(str.c_str(), &code, &err, LDAP_SCHEMA_ALLOW_ALL);
+            if (!at)
+                return;
+            if (at->at_names) {
+                for (char** p = at->at_names; *p; ++p) {
+                    std::string key = QoreLdapResultOpts::getKey(*p);
+                    if (at->at_syntax_oid)
+                        syntax[key] = at->at_syntax_oid;
+                    else if (at->at_sup_oid)
+                        sup[key] = QoreLdapResultOpts::getKey(at->at_sup_oid);
+                }
+            }
+            ldap_attributetype_free(at);
+        };
+
+        if (v.getType() == NT_STRING)
+            add(*v.get<const QoreStringNode>());
+        else if (v.getType() == NT_LIST) {
+            ConstListIterator li(v.get<const QoreListNode>());
+            while (li.next()) {
+                if (li.getValue().getType() == NT_STRING)
+                    add(*li.getValue().get<const QoreStringNode>());
+            }
+        }
+
+        // resolve inherited syntaxes
+        for (auto& i : sup) {
+            std::string name = i.second;
+            // limit the depth in case of a circular hierarchy
+            for (unsigned depth = 0; depth < 16; ++depth) {
+                str_map_t::iterator si = syntax.find(name);
+                if (si != syntax.end()) {
+                    syntax[i.first] = si->second;
+                    break;
+                }
+                str_map_t::iterator pi = sup.find(name);
+                if (pi == sup.end())
+                    break;
+                name = pi->second;
+            }
+        }
+
+        for (auto& i : syntax) {
+            // the syntax OID may have a length restriction suffix: "{n}"
+            std::string oid = i.second.substr(0, i.second.find('{'));
+            if (oid == "1.3.6.1.4.1.1466.115.121.1.27")
+                types[i.first] = QLT_INT;
+            else if (oid == "1.3.6.1.4.1.1466.115.121.1.24")
+                types[i.first] = QLT_DATE;
+            else if (oid == "1.3.6.1.4.1.1466.115.121.1.7")
+                types[i.first] = QLT_BOOL;
+        }
+    }
+
+    // prepares the result options for the search; must be called without the lock held
+    DLLLOCAL int prepareSearch(QoreLdapSearchParams& sp, ExceptionSink* xsink, int my_timeout_ms = 0) {
+        if (!sp.ropts.typed || sp.ropts.types)
+            return 0;
+        sp.ropts.types = getSchemaTypes(xsink, my_timeout_ms);
+        return *xsink ? -1 : 0;
+    }
+
+    DLLLOCAL QoreValue search(ExceptionSink* xsink, const QoreHashNode& h, int my_timeout_ms = 0) {
+        QoreLdapSearchParams sp(xsink);
+        if (sp.parse(h))
+            return QoreValue();
+
+        if (!cache || !cache->cacheSearch() || !sp.use_cache)
+            return retryIntern(xsink, true, [&] () { return searchIntern(xsink, sp, my_timeout_ms); });
+
+        std::string key = sp.getCacheKey();
+        QoreValue rv = cache->get(key);
+        if (!rv.isNothing())
+            return rv;
+
+        // retrieved before the search is sent so that a result that is invalidated while the search is in progress
+        // is not cached
+        int64 gen = cache->getGeneration();
+        // searches that find no entries, including searches whose base does not exist, are negative outcomes
+        size_t count;
+        rv = retryIntern(xsink, true, [&] () { return searchIntern(xsink, sp, my_timeout_ms, &count); });
+        if (!rv.isNothing())
+            cache->put(key, gen, sp.base ? sp.base->c_str() : "", rv, !count);
+        return rv;
+    }
+
+    // enables the given search result cache; used to share a cache between the sessions in a pool
+    DLLLOCAL void setSearchCache(std::shared_ptr<QoreLdapSearchCache> c) {
+        AutoLocker al(m);
+        cache = c;
+    }
+
+    // returns search cache statistics or 0 if there is no cache
+    DLLLOCAL QoreHashNode* getCacheStats() const {
+        return cache ? cache->getStats() : 0;
+    }
+
+    // removes all results from the search cache
+    DLLLOCAL void clearCache() {
+        if (cache)
+            cache->clear();
+    }
+
+    // returns the state of each server or 0 if only one server is configured
+    DLLLOCAL QoreListNode* getServers() const {
+        return servers ? servers->getInfo(server_idx) : 0;
+    }
+
+    // returns operation statistics
+    DLLLOCAL QoreHashNode* getStats() const {
+        return stats.get();
+    }
+
+    // resets all operation statistics
+    DLLLOCAL void resetStats() {
+        stats.reset();
+    }
+
+protected:
+    // executes the search; if \a count is not 0, then the number of entries found is returned in \a count
+    DLLLOCAL QoreValue searchIntern(ExceptionSink* xsink, QoreLdapSearchParams& sp, int my_timeout_ms, size_t* count = nullptr) {
+        if (prepareSearch(sp, xsink, my_timeout_ms))
+            return QoreValue();
+
+        OpHelper oh(this, "search", xsink);
+        oh.setSearch(sp.base, sp.filter);
+        int msgid = searchStart(oh, sp, xsink);
+        if (msgid < 0)
+            return QoreValue();
+
+        QoreLdapMessageList res;
+        if (oh.getResults("ldap_search_ext", QLO_SEARCH, msgid, my_timeout_ms, res))
+            return QoreValue();
+
+        QoreLdapSearchResult r(sp.ropts, *sp.attrl, xsink);
+        if (!sp.page_size) {
+            if (addSearchResultIntern(r, res, xsink))
+                return QoreValue();
+            oh.addResults(r.size(), r.bytes);
+            if (count)
+                *count = r.size();
+            if (sp.vlv)
+                return makeVlvResultIntern(res, r.release(), xsink);
+            return r.release();
+        }
+
+        // retrieve all pages with the session lock held
+        QoreLdapPageCookie cookie;
+        while (true) {
+            if (addSearchResultIntern(r, res, xsink) || getPageCookieIntern("search", res, cookie, xsink))
+                return QoreValue();
+            if (!cookie)
+                break;
+
+            QoreLdapMessageList next;
+            msgid = searchStart(oh, sp, xsink, &cookie);
+            if (msgid < 0 || oh.getResults("ldap_search_ext", QLO_SEARCH, msgid, my_timeout_ms, next))
+                return QoreValue();
+            res.swap(next);
+        }
+
+        oh.addResults(r.size(), r.bytes);
+        if (count)
+            *count = r.size();
+        return r.release();
+    }
+
+    // returns a hash of the entries in the window of a virtual list view search and the state of the list from the
+    // server's response control
+    DLLLOCAL QoreHashNode* makeVlvResultIntern(QoreLdapMessageList& res, QoreValue entries, ExceptionSink* xsink) {
+        ValueHolder holder(entries, xsink);
+        LDAPMessage* msg = findSearchResultIntern(res);
+        if (!msg) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "no search result was received for the virtual list view search");
+            return nullptr;
+        }
+
+        QoreLdapParseResultHelper prh("search", "ldap_search_ext", this, msg, xsink, true, false);
+        if (*xsink || prh.check())
+            return nullptr;
+
+        LDAPControl* ctrl = prh.findControl(LDAP_CONTROL_VLVRESPONSE);
+        if (!ctrl) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the server did not return a virtual list view response control; the server may not support the control");
+            return nullptr;
+        }
+
+        ber_int_t target_pos, list_count, err;
+        berval* context = nullptr;
+        if (checkLdapError("search", "ldap_parse_vlvresponse_control", ldap_parse_vlvresponse_control(ldp, ctrl, &target_pos, &list_count, &context, &err), xsink))
+            return nullptr;
+        ON_BLOCK_EXIT(ber_bvfree, context);
+        if (err != LDAP_SUCCESS) {
+            doLdapError("search", "ldap_parse_vlvresponse_control", err, xsink);
+            return nullptr;
+        }
+
+        ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+        h->setKeyValue("entries", holder.release(), xsink);
+        h->setKeyValue("target_position", (int64)target_pos, xsink);
+        h->setKeyValue("content_count", (int64)list_count, xsink);
+        if (context && context->bv_len) {
+            BinaryNode* b = new BinaryNode;
+            b->append(context->bv_val, context->bv_len);
+            h->setKeyValue("context", b, xsink);
+        }
+        return h.release();
+    }
+
+    // returns the persistent search change type for the given name or 0 if the name is invalid
+    DLLLOCAL static int getChangeType(const char* name) {
+        if (!strcmp(name, "add"))
+            return LDAP_CONTROL_PERSIST_ENTRY_CHANGE_ADD;
+        if (!strcmp(name, "delete"))
+            return LDAP_CONTROL_PERSIST_ENTRY_CHANGE_DELETE;
+        if (!strcmp(name, "modify"))
+            return LDAP_CONTROL_PERSIST_ENTRY_CHANGE_MODIFY;
+        if (!strcmp(name, "moddn"))
+            return LDAP_CONTROL_PERSIST_ENTRY_CHANGE_RENAME;
+        return 0;
+    }
+
+    // returns the name of the given persistent search change type
+    DLLLOCAL static const char* getChangeTypeName(int ct) {
+        switch (ct) {
+            case LDAP_CONTROL_PERSIST_ENTRY_CHANGE_ADD: return "add";
+            case LDAP_CONTROL_PERSIST_ENTRY_CHANGE_DELETE: return "delete";
+            case LDAP_CONTROL_PERSIST_ENTRY_CHANGE_RENAME: return "moddn";
+            default: return "modify";
+        }
+    }
+
+    // starts a persistent search; returns -1 if an exception was raised
+    DLLLOCAL int psearchStart(ExceptionSink* xsink, QoreLdapSearchStream& ss, int change_types) {
+        // PersistentSearch ::= SEQUENCE { changeTypes INTEGER, changesOnly BOOLEAN, returnECs BOOLEAN }
+        BerElement* ber = ber_alloc_t(LBER_USE_DER);
+        if (!ber) {
+            xsink->outOfMemory();
+            return -1;
+        }
+        ON_BLOCK_EXIT(ber_free, ber, 1);
+        berval bv;
+        if (ber_printf(ber, "{ibb}", (ber_int_t)change_types, (ber_int_t)1, (ber_int_t)1) == -1 || ber_flatten2(ber, &bv, 0) == -1) {
+            doLdapError("watch", "ber_printf", LDAP_ENCODING_ERROR, xsink);
+            return -1;
+        }
+
+        LDAPControl* ctrl = 0;
+        if (checkLdapError("watch", "ldap_control_create", ldap_control_create(LDAP_CONTROL_PERSIST_REQUEST, 1, &bv, 1, &ctrl), xsink))
+            return -1;
+        ON_BLOCK_EXIT(ldap_control_free, ctrl);
+
+        return streamStart(xsink, ss, "watch", ctrl);
+    }
+
+    // parses the entry change notification control of an entry returned by a persistent search; the lock must be
+    // held; returns -1 if an exception was raised
+    DLLLOCAL int getEntryChangeIntern(LDAPMessage* e, int& change_type, std::string& prev_dn, int64& change_number, ExceptionSink* xsink) {
+        LDAPControl** ctrls = 0;
+        if (checkLdapError("watch", "ldap_get_entry_controls", ldap_get_entry_controls(ldp, e, &ctrls), xsink))
+            return -1;
+        LDAPControl* ctrl = ctrls ? ldap_control_find(LDAP_CONTROL_PERSIST_ENTRY_CHANGE_NOTICE, ctrls, 0) : 0;
+        if (!ctrl) {
+            if (ctrls)
+                ldap_controls_free(ctrls);
+            xsink->raiseException("LDAP-WATCH-ERROR", "the server returned an entry without an entry change notification control");
+            return -1;
+        }
+        ON_BLOCK_EXIT(ldap_controls_free, ctrls);
+
+        // EntryChangeNotification ::= SEQUENCE { changeType ENUMERATED, previousDN LDAPDN OPTIONAL,
+        //     changeNumber INTEGER OPTIONAL }
+        BerElement* ber = ber_init(&ctrl->ldctl_value);
+        if (!ber) {
+            xsink->outOfMemory();
+            return -1;
+        }
+        ON_BLOCK_EXIT(ber_free, ber, 1);
+        ber_int_t ct;
+        if (ber_scanf(ber, "{e", &ct) == LBER_ERROR) {
+            xsink->raiseException("LDAP-WATCH-ERROR", "the server returned an invalid entry change notification control");
+            return -1;
+        }
+        change_type = ct;
+        getBerOptionalString(ber, LBER_OCTETSTRING, prev_dn);
+        ber_len_t len;
+        if (ber_peek_tag(ber, &len) == LBER_INTEGER) {
+            ber_int_t cn;
+            if (ber_scanf(ber, "i", &cn) != LBER_ERROR)
+                change_number = cn;
+        }
+        return 0;
+    }
+
+    // executes a watch on this dedicated session
+    DLLLOCAL int64 watchIntern(ExceptionSink* xsink, QoreLdapSearchStream& ss, const ResolvedCallReferenceNode* cb, bool sync, int change_types, int idle_ms) {
+        if (sync ? syncStart(xsink, ss, "watch", LDAP_SYNC_REFRESH_AND_PERSIST, std::string()) : psearchStart(xsink, ss, change_types))
+            return -1;
+
+        // with the sync control, the DNs of all entries are tracked to report renames and deletes
+        std::map<std::string, std::string> dns;
+        bool in_refresh = sync;
+        int64 count = 0;
+        int64 start = q_clock_getmicros();
+        while (true) {
+            int wait_ms = timeout_ms;
+            if (idle_ms) {
+                wait_ms = idle_ms - (int)((q_clock_getmicros() - start) / 1000);
+                if (wait_ms <= 0)
+                    break;
+            }
+
+            LDAPMessage* msg = 0;
+            int rc = streamNext(xsink, ss, "watch", wait_ms, msg);
+            if (rc < 0)
+                return -1;
+            if (!rc)
+                continue;
+            ON_BLOCK_EXIT(ldap_msgfree, msg);
+
+            ReferenceHolder<QoreHashNode> event(xsink);
+            int type = ldap_msgtype(msg);
+            if (type == LDAP_RES_SEARCH_RESULT) {
+                QoreLdapParseResultHelper prh("watch", "ldap_search_ext", this, msg, xsink, false, false);
+                if (*xsink || prh.check())
+                    return -1;
+                // the server ended the search
+                return count;
+            }
+
+            if (type == LDAP_RES_INTERMEDIATE && sync) {
+                QoreLdapSyncInfo info;
+                {
+                    AutoLocker al(m);
+                    if (getSyncInfoIntern("watch", msg, info, xsink) < 0)
+                        return -1;
+                }
+                if ((info.tag == LDAP_TAG_SYNC_REFRESH_DELETE || info.tag == LDAP_TAG_SYNC_REFRESH_PRESENT) && info.refresh_done)
+                    in_refresh = false;
+                else if (info.tag == LDAP_TAG_SYNC_ID_SET && info.refresh_deletes && !in_refresh) {
+                    for (auto& uuid : info.uuids) {
+                        std::map<std::string, std::string>::iterator i = dns.find(uuid);
+                        if (i == dns.end())
+                            continue;
+                        event = new QoreHashNode;
+                        event->setKeyValue("type", new QoreStringNode("delete"), xsink);
+                        event->setKeyValue("dn", new QoreStringNode(i->second.c_str(), QCS_UTF8), xsink);
+                        dns.erase(i);
+                        ++count;
+                        if (!watchCallback(cb, **event, xsink)) {
+                            searchEnd(ss, xsink);
+                            return *xsink ? -1 : count;
+                        }
+                    }
+                    event = nullptr;
+                }
+                continue;
+            }
+
+            if (type != LDAP_RES_SEARCH_ENTRY)
+                continue;
+
+            {
+                AutoLocker al(m);
+                ReferenceHolder<QoreHashNode> entry(makeEntryIntern(msg, xsink, &ss.sp.ropts), xsink);
+                if (!entry)
+                    return -1;
+                const QoreStringNode* dn = entry->getKeyValue("dn").get<const QoreStringNode>();
+
+                const char* tname;
+                std::string prev_dn;
+                int64 change_number = -1;
+                if (sync) {
+                    int state;
+                    std::string uuid, ck;
+                    if (getSyncStateIntern("watch", msg, state, uuid, ck, xsink))
+                        return -1;
+                    std::map<std::string, std::string>::iterator i = dns.find(uuid);
+                    if (state == LDAP_SYNC_DELETE) {
+                        if (i != dns.end())
+                            dns.erase(i);
+                        tname = "delete";
+                    } else {
+                        if (state == LDAP_SYNC_ADD && i == dns.end())
+                            tname = "add";
+                        else if (i != dns.end() && QoreLdapSearchCache::normalizeDn(i->second.c_str()) != QoreLdapSearchCache::normalizeDn(dn->c_str())) {
+                            tname = "moddn";
+                            prev_dn = i->second;
+                        } else
+                            tname = "modify";
+                        dns[uuid] = dn->c_str();
+                    }
+                    // entries in the refresh phase are the current content and are not reported as changes
+                    if (in_refresh || state == LDAP_SYNC_PRESENT)
+                        continue;
+                } else {
+                    int ct;
+                    if (getEntryChangeIntern(msg, ct, prev_dn, change_number, xsink))
+                        return -1;
+                    tname = getChangeTypeName(ct);
+                }
+
+                event = new QoreHashNode;
+                event->setKeyValue("type", new QoreStringNode(tname), xsink);
+                event->setKeyValue("dn", dn->refSelf(), xsink);
+                if (strcmp(tname, "delete") || !sync)
+                    event->setKeyValue("attributes", entry->getKeyValue("attributes").refSelf(), xsink);
+                if (!prev_dn.empty())
+                    event->setKeyValue("previous_dn", new QoreStringNode(prev_dn.c_str(), QCS_UTF8), xsink);
+                if (change_number >= 0)
+                    event->setKeyValue("change_number", change_number, xsink);
+            }
+
+            ++count;
+            if (!watchCallback(cb, **event, xsink)) {
+                searchEnd(ss, xsink);
+                return *xsink ? -1 : count;
+            }
+        }
+
+        searchEnd(ss, xsink);
+        return count;
+    }
+
+    // calls the watch callback with the given event; returns false if the watch should be stopped
+    DLLLOCAL static bool watchCallback(const ResolvedCallReferenceNode* cb, QoreHashNode& event, ExceptionSink* xsink) {
+        ReferenceHolder<QoreListNode> args(new QoreListNode(autoTypeInfo), xsink);
+        args->push(event.hashRefSelf(), xsink);
+        ValueHolder rv(cb->execValue(*args, xsink), xsink);
+        if (*xsink)
+            return false;
+        // stop if the callback explicitly returns False
+        return rv->getType() != NT_BOOLEAN || rv->getAsBool();
+    }
+
+public:
+    DLLLOCAL int add(ExceptionSink* xsink, const QoreStringNode* dn, const QoreHashNode* attr, int my_timeout_ms = 0) {
+        return retryIntern(xsink, false, [&] () -> int {
+            OpHelper oh(this, "add", xsink);
+            oh.setTarget(dn);
+            int msgid = addStart(oh, dn, attr, xsink);
+            if (msgid < 0)
+                return -1;
+
+            LDAPMessage* res = oh.getResult("ldap_add_ext", QLO_ADD, msgid, my_timeout_ms);
+            oh.invalidateDone();
+            if (!res)
+                return -1;
+
+            return checkFreeResult("add", "ldap_add_ext", res, xsink);
+        });
+    }
+
+    DLLLOCAL int modify(ExceptionSink* xsink, const QoreStringNode* dn, const QoreListNode* ml, int my_timeout_ms = 0) {
+        return retryIntern(xsink, false, [&] () -> int {
+            OpHelper oh(this, "modify", xsink);
+            oh.setTarget(dn);
+            int msgid = modifyStart(oh, dn, ml, xsink);
+            if (msgid < 0)
+                return -1;
+
+            LDAPMessage* res = oh.getResult("ldap_modify_ext", QLO_MODIFY, msgid, my_timeout_ms);
+            oh.invalidateDone();
+            if (!res)
+                return -1;
+
+            return checkFreeResult("modify", "ldap_modify_ext", res, xsink);
+        });
+    }
+
+    DLLLOCAL int del(ExceptionSink* xsink, const QoreStringNode* dn, int my_timeout_ms = 0) {
+        return retryIntern(xsink, false, [&] () -> int {
+            OpHelper oh(this, "del", xsink);
+            oh.setTarget(dn);
+            int msgid = delStart(oh, dn, xsink);
+            if (msgid < 0)
+                return -1;
+
+            LDAPMessage* res = oh.getResult("ldap_delete_ext", QLO_DELETE, msgid, my_timeout_ms);
+            oh.invalidateDone();
+            if (!res)
+                return -1;
+
+            return checkFreeResult("del", "ldap_delete_ext", res, xsink);
+        });
+    }
+
+    DLLLOCAL bool compare(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* attr, const QoreListNode* vl, int my_timeout_ms = 0) {
+        std::string key, dnutf8;
+        int64 gen = 0;
+        if (cache && cache->cacheCompare()) {
+            if (getCompareKeyIntern(dn, attr, vl, key, dnutf8, xsink))
+                return false;
+            QoreValue v = cache->get(key);
+            if (!v.isNothing()) {
+                if (v.getType() == NT_BOOLEAN)
+                    return v.getAsBool();
+                // a cached error for a missing entry
+                xsink->raiseException("LDAP-RESULT-ERROR", v.get<QoreStringNode>());
+                return false;
+            }
+            gen = cache->getGeneration();
+        }
+
+        QoreStringNode* nso = nullptr;
+        bool rv = retryIntern(xsink, true, [&] () {
+            return compareIntern(xsink, dn, attr, vl, my_timeout_ms, key.empty() ? nullptr : &nso);
+        });
+        if (key.empty())
+            return rv;
+
+        if (nso) {
+            cache->put(key, gen, dnutf8.c_str(), nso, true);
+            nso->deref();
+        } else if (!*xsink) {
+            cache->put(key, gen, dnutf8.c_str(), rv, !rv);
+        }
+        return rv;
+    }
+
+protected:
+    // executes a compare operation; the error description is returned in \a nso if the entry does not exist
+    DLLLOCAL bool compareIntern(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* attr, const QoreListNode* vl, int my_timeout_ms, QoreStringNode** nso) {
+        OpHelper oh(this, "compare", xsink);
+        oh.setTarget(dn);
+        int msgid = compareStart(oh, dn, attr, vl, xsink);
+        if (msgid < 0)
+            return false;
+
+        LDAPMessage* res = oh.getResult("ldap_compare_ext", QLO_COMPARE, msgid, my_timeout_ms);
+        if (!res)
+            return false;
+
+        return compareResultIntern("compare", "ldap_compare_ext", res, xsink, nso);
+    }
+
+public:
+    DLLLOCAL int rename(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* newrdn, const QoreStringNode* newparent, bool deleteoldrdn = true, int my_timeout_ms = 0) {
+        return retryIntern(xsink, false, [&] () -> int {
+            OpHelper oh(this, "rename", xsink);
+            oh.setTarget(dn);
+            int msgid = renameStart(oh, dn, newrdn, newparent, deleteoldrdn, xsink);
+            if (msgid < 0)
+                return -1;
+
+            LDAPMessage* res = oh.getResult("ldap_rename", QLO_RENAME, msgid, my_timeout_ms);
+            oh.invalidateDone();
+            if (!res)
+                return -1;
+
+            return checkFreeResult("rename", "ldap_rename", res, xsink);
+        });
+    }
+
+    DLLLOCAL int passwd(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* op, const QoreStringNode* np, int my_timeout_ms = 0) {
+        return retryIntern(xsink, false, [&] () -> int {
+            OpHelper oh(this, "passwd", xsink);
+            oh.setTarget(dn);
+            int msgid = passwdStart(oh, dn, op, np, xsink);
+            if (msgid < 0)
+                return -1;
+
+            LDAPMessage* res = oh.getResult("ldap_passwd", QLO_PASSWD, msgid, my_timeout_ms);
+            if (!res)
+                return -1;
+
+            return checkFreeResult("passwd", "ldap_passwd", res, xsink);
+        });
+    }
+
+    DLLLOCAL int64 searchAsync(ExceptionSink* xsink, const QoreHashNode& h) {
+        QoreLdapSearchParams sp(xsink);
+        if (sp.parse(h) || prepareSearch(sp, xsink))
+            return -1;
+        // subsequent pages can only be requested by a thread retrieving the results
+        if (sp.page_size) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the 'page_size' option is not supported by LdapClient::searchAsync(); use LdapClient::searchIterator() instead");
+            return -1;
+        }
+        if (sp.vlv) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the 'vlv' option is only supported by LdapClient::search()");
+            return -1;
+        }
+
+        OpHelper oh(this, "searchAsync", xsink);
+        int msgid = searchStart(oh, sp, xsink);
+        if (msgid < 0)
+            return -1;
+        int64 handle = oh.registerAsync(msgid, "ldap_search_ext", QLO_SEARCH);
+        QoreLdapPendingOp* op = pending[msgid];
+        op->ropts = sp.ropts;
+        if (sp.ropts.format == QLF_COLUMNAR && sp.attrl) {
+            ConstListIterator li(*sp.attrl);
+            while (li.next()) {
+                QoreValue v = li.getValue();
+                if (v.getType() == NT_STRING)
+                    op->attrs.push_back(v.get<const QoreStringNode>()->c_str());
+            }
+        }
+        return handle;
+    }
+
+    DLLLOCAL int64 addAsync(ExceptionSink* xsink, const QoreStringNode* dn, const QoreHashNode* attr) {
+        OpHelper oh(this, "addAsync", xsink);
+        int msgid = addStart(oh, dn, attr, xsink);
+        return msgid < 0 ? -1 : oh.registerAsync(msgid, "ldap_add_ext", QLO_ADD);
+    }
+
+    DLLLOCAL int64 modifyAsync(ExceptionSink* xsink, const QoreStringNode* dn, const QoreListNode* ml) {
+        OpHelper oh(this, "modifyAsync", xsink);
+        int msgid = modifyStart(oh, dn, ml, xsink);
+        return msgid < 0 ? -1 : oh.registerAsync(msgid, "ldap_modify_ext", QLO_MODIFY);
+    }
+
+    DLLLOCAL int64 delAsync(ExceptionSink* xsink, const QoreStringNode* dn) {
+        OpHelper oh(this, "delAsync", xsink);
+        int msgid = delStart(oh, dn, xsink);
+        return msgid < 0 ? -1 : oh.registerAsync(msgid, "ldap_delete_ext", QLO_DELETE);
+    }
+
+    DLLLOCAL int64 compareAsync(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* attr, const QoreListNode* vl) {
+        OpHelper oh(this, "compareAsync", xsink);
+        int msgid = compareStart(oh, dn, attr, vl, xsink);
+        return msgid < 0 ? -1 : oh.registerAsync(msgid, "ldap_compare_ext", QLO_COMPARE);
+    }
+
+    DLLLOCAL int64 renameAsync(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* newrdn, const QoreStringNode* newparent, bool deleteoldrdn = true) {
+        OpHelper oh(this, "renameAsync", xsink);
+        int msgid = renameStart(oh, dn, newrdn, newparent, deleteoldrdn, xsink);
+        return msgid < 0 ? -1 : oh.registerAsync(msgid, "ldap_rename", QLO_RENAME);
+    }
+
+    // removes the pending operation for the current request of the given stream; the lock must be held
+    /** the request is recorded in the statistics; the wait phase covers the time from sending the request until the
+        search ended
+
+        @return the trace for the slow operation callback, which must be passed to callSlowCallback() or
+        OpHelper::addTrace() by the caller, or 0 if the callback is not called for the request
+    */
+    DLLLOCAL QoreHashNode* endStreamIntern(QoreLdapSearchStream& ss, ExceptionSink* xsink) {
+        QoreHashNode* trace = nullptr;
+        if (ss.msgid != -1) {
+            // the request was discarded if the session context has been reinitialized
+            ldap_pending_map_t::iterator i = ss.gen == ctx_gen ? pending.find(ss.msgid) : pending.end();
+            if (i != pending.end()) {
+                QoreLdapOpTimer t(stats, xsink, QLS_SEARCH, QLP_WAIT, i->second->sent);
+                t.msgid = ss.msgid;
+                t.base = ss.sp.base;
+                t.filter = ss.sp.filter;
+                t.result = i->second->err;
+                t.failed = i->second->err != LDAP_SUCCESS;
+                t.addResults(i->second->entries, 0);
+                trace = traceDoneIntern(t, xsink);
+                removeOpIntern(ss.msgid);
+            }
+            ss.msgid = -1;
+        }
+        return trace;
+    }
+
+    // starts a search whose entries are retrieved one at a time with searchNext(); returns -1 if an exception was raised
+    DLLLOCAL int searchStream(ExceptionSink* xsink, QoreLdapSearchStream& ss, const char* meth = "searchIterator") {
+        if (prepareSearch(ss.sp, xsink))
+            return -1;
+
+        OpHelper oh(this, meth, xsink);
+        int msgid = searchStart(oh, ss.sp, xsink);
+        if (msgid < 0)
+            return -1;
+        oh.registerStream(ss, msgid);
+        return 0;
+    }
+
+    // retrieves the next entry of a search started with searchStream()
+    /** subsequent pages of a paged search are requested automatically when the previous page is complete
+
+        @return 1 if an entry was returned, 0 if the search is complete, -1 if an exception was raised; the
+        operation remains pending only if 1 is returned or the wait timed out
+    */
+    DLLLOCAL int searchNext(ExceptionSink* xsink, QoreLdapSearchStream& ss, int my_timeout_ms, ReferenceHolder<QoreHashNode>& entry) {
+        return searchNextIntern(xsink, ss, "searchIterator", my_timeout_ms, [&] (LDAPMessage* e) -> int {
+            entry = makeEntryIntern(e, xsink, &ss.sp.ropts, false, nullptr, &ss.intern);
+            return *xsink ? -1 : 0;
+        });
+    }
+
+    // retrieves the next entry of a search started with searchStream() and calls the given function with it with
+    // the lock held; the function returns -1 if an exception was raised
+    /** @return 1 if an entry was processed, 0 if the search is complete, -1 if an exception was raised
+    */
+    template <typename F>
+    DLLLOCAL int searchNextIntern(ExceptionSink* xsink, QoreLdapSearchStream& ss, const char* meth, int my_timeout_ms, F f) {
+        OpHelper oh(this, meth, xsink);
+        if (oh.lock())
+            return -1;
+
+        if (!hasStreamOpIntern(ss)) {
+            ss.msgid = -1;
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the search was discarded when the session was rebound or reconnected");
+            return -1;
+        }
+
+        while (true) {
+            QoreLdapPendingOp* op;
+            int rc = waitOpIntern(ss.msgid, false, my_timeout_ms ? my_timeout_ms : timeout_ms, op);
+            if (!op) {
+                xsink->raiseException("LDAP-SEARCH-ERROR", "the search was ended in another thread while waiting for its responses");
+                return -1;
+            }
+            if (!rc) {
+                doLdapError(meth, "ldap_search_ext", LDAP_TIMEOUT, xsink);
+                return -1;
+            }
+            if (rc < 0) {
+                int err = op->err;
+                oh.addTrace(endStreamIntern(ss, xsink));
+                doLdapError(meth, "ldap_search_ext", err, xsink);
+                return -1;
+            }
+            if (op->msgs.empty()) {
+                assert(op->done);
+                oh.addTrace(endStreamIntern(ss, xsink));
+                return 0;
+            }
+
+            LDAPMessage* msg = op->msgs.front();
+            op->msgs.pop_front();
+            ON_BLOCK_EXIT(ldap_msgfree, msg);
+
+            int type = ldap_msgtype(msg);
+            if (type == LDAP_RES_SEARCH_ENTRY) {
+                ++op->entries;
+                if (f(msg)) {
+                    oh.addTrace(endStreamIntern(ss, xsink));
+                    return -1;
+                }
+                return 1;
+            }
+            if (type == LDAP_RES_SEARCH_RESULT) {
+                oh.addTrace(endStreamIntern(ss, xsink));
+                if (!ss.sp.page_size)
+                    return 0;
+
+                // request the next page if there is one
+                if (getPageCookieIntern(meth, msg, ss.cookie, xsink))
+                    return -1;
+                if (!ss.cookie)
+                    return 0;
+
+                int msgid = searchStart(oh, ss.sp, xsink, &ss.cookie);
+                if (msgid < 0)
+                    return -1;
+                oh.registerStream(ss, msgid);
+            }
+            // search references and intermediate responses are ignored
+        }
+    }
+
+    // ends a search started with searchStream() or syncStart(); the search is abandoned if it's not complete
+    DLLLOCAL void searchEnd(QoreLdapSearchStream& ss, ExceptionSink* xsink) {
+        QoreHashNode* trace;
+        {
+            AutoLocker al(m);
+            trace = endStreamIntern(ss, xsink);
+        }
+        if (trace)
+            callSlowCallback(trace, xsink);
+    }
+
+    // starts a search with the given server control whose responses are retrieved with streamNext(); returns -1 if
+    // an exception was raised
+    /** the search must already have been prepared with prepareSearch()
+    */
+    DLLLOCAL int streamStart(ExceptionSink* xsink, QoreLdapSearchStream& ss, const char* meth, LDAPControl* ctrl) {
+        OpHelper oh(this, meth, xsink);
+        int msgid = searchStart(oh, ss.sp, xsink, nullptr, ctrl);
+        if (msgid < 0)
+            return -1;
+        oh.registerStream(ss, msgid);
+        return 0;
+    }
+
+    // retrieves the next response of a search started with streamStart(); the caller must free the message
+    /** @return 1 if a response was returned, 0 if the wait timed out, -1 if an exception was raised; the operation
+        is removed when the final response is returned
+    */
+    DLLLOCAL int streamNext(ExceptionSink* xsink, QoreLdapSearchStream& ss, const char* meth, int my_timeout_ms, LDAPMessage*& msg) {
+        OpHelper oh(this, meth, xsink);
+        if (oh.lock())
+            return -1;
+
+        if (!hasStreamOpIntern(ss)) {
+            ss.msgid = -1;
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the search was discarded when the session was rebound or reconnected");
+            return -1;
         }
 
-        if (bh) {
-            bh->deref(xsink);
-            bh = 0;
+        QoreLdapPendingOp* op;
+        int rc = waitOpIntern(ss.msgid, false, my_timeout_ms, op);
+        if (!op) {
+            xsink->raiseException("LDAP-SEARCH-ERROR", "the search was ended in another thread while waiting for its responses");
+            return -1;
+        }
+        if (!rc)
+            return 0;
+        if (rc < 0 || op->msgs.empty()) {
+            int err = op->err;
+            oh.addTrace(endStreamIntern(ss, xsink));
+            doLdapError(meth, "ldap_search_ext", err == LDAP_SUCCESS ? LDAP_OTHER : err, xsink);
+            return -1;
         }
 
-        return 0;
+        msg = op->msgs.front();
+        op->msgs.pop_front();
+        if (ldap_msgtype(msg) == LDAP_RES_SEARCH_ENTRY)
+            ++op->entries;
+        else if (ldap_msgtype(msg) == LDAP_RES_SEARCH_RESULT)
+            oh.addTrace(endStreamIntern(ss, xsink));
+        return 1;
     }
 
-    DLLLOCAL bool isSecure(ExceptionSink* xsink) {
-        AutoLocker al(m);
-        if (checkValidIntern("isSecure", xsink))
+    // starts a content synchronization search (RFC 4533) with the given mode and cookie; returns -1 if an exception
+    // was raised
+    /** responses are retrieved with streamNext()
+    */
+    DLLLOCAL int syncStart(ExceptionSink* xsink, QoreLdapSearchStream& ss, const char* meth, int mode, const std::string& cookie) {
+        if (prepareSearch(ss.sp, xsink))
             return -1;
 
-        return ldap_tls_inplace(ldp);
-    }
-
-    DLLLOCAL int bind(ExceptionSink* xsink, const QoreHashNode& bindh, int my_timeout_ms = 0) {
-        AutoLocker al(m);
-        if (checkValidIntern("bind", xsink))
+        // syncRequestValue ::= SEQUENCE { mode ENUMERATED, cookie syncCookie OPTIONAL, reloadHint BOOLEAN DEFAULT FALSE }
+        BerElement* ber = ber_alloc_t(LBER_USE_DER);
+        if (!ber) {
+            xsink->outOfMemory();
+            return -1;
+        }
+        ON_BLOCK_EXIT(ber_free, ber, 1);
+        berval cbv;
+        cbv.bv_val = (char*)cookie.data();
+        cbv.bv_len = cookie.size();
+        int rc = cookie.empty()
+            ? ber_printf(ber, "{e}", (ber_int_t)mode)
+            : ber_printf(ber, "{eO}", (ber_int_t)mode, &cbv);
+        berval bv;
+        if (rc == -1 || ber_flatten2(ber, &bv, 0) == -1) {
+            doLdapError(meth, "ber_printf", LDAP_ENCODING_ERROR, xsink);
             return -1;
+        }
 
-        if (unbindIntern(xsink, my_timeout_ms))
+        LDAPControl* ctrl = 0;
+        if (checkLdapError(meth, "ldap_control_create", ldap_control_create(LDAP_CONTROL_SYNC, 1, &bv, 1, &ctrl), xsink))
             return -1;
+        ON_BLOCK_EXIT(ldap_control_free, ctrl);
 
-        return bindInitIntern(xsink, "bind", bindh, my_timeout_ms);
+        return streamStart(xsink, ss, meth, ctrl);
     }
 
-    DLLLOCAL QoreHashNode* search(ExceptionSink* xsink, const QoreStringNode* base, int scope, const QoreStringNode* filter, const QoreListNode* attrl = 0, bool attrsonly = false, int my_timeout_ms = 0) {
-        // convert strings to UTF-8 if necessary
-        QoreStringValueHelper bstr(base, QCS_UTF8, xsink);
-        if (*xsink)
-            return 0;
+    // returns the value of an optional OCTET STRING with the given tag at the current position of the BER element
+    DLLLOCAL static bool getBerOptionalString(BerElement* ber, ber_tag_t tag, std::string& str) {
+        ber_len_t len;
+        if (ber_peek_tag(ber, &len) != tag)
+            return false;
+        berval bv;
+        if (ber_scanf(ber, "m", &bv) == LBER_ERROR)
+            return false;
+        str.assign(bv.bv_val, bv.bv_len);
+        return true;
+    }
 
-        QoreStringValueHelper fstr(filter, QCS_UTF8, xsink);
-        if (*xsink)
-            return 0;
+    // returns the value of an optional BOOLEAN with the given tag at the current position or the given default value
+    DLLLOCAL static bool getBerOptionalBool(BerElement* ber, ber_tag_t tag, bool def) {
+        ber_len_t len;
+        if (ber_peek_tag(ber, &len) != tag)
+            return def;
+        ber_int_t b;
+        if (ber_scanf(ber, "b", &b) == LBER_ERROR)
+            return def;
+        return (bool)b;
+    }
 
-        // get attribute list
-        AttrListHelper attrs(attrl, xsink);
-        if (*xsink)
-            return 0;
+    DLLLOCAL static int syncError(const char* msg, ExceptionSink* xsink) {
+        xsink->raiseException("LDAP-SYNC-ERROR", "invalid content synchronization response from the server: %s", msg);
+        return -1;
+    }
 
-        AutoLocker al(m);
-        if (checkValidIntern("search", xsink))
-            return 0;
+    // parses the sync state control of a search entry received by a content synchronization search; the lock must
+    // be held; returns -1 if an exception was raised
+    DLLLOCAL int getSyncStateIntern(const char* meth, LDAPMessage* e, int& state, std::string& uuid, std::string& cookie, ExceptionSink* xsink) {
+        LDAPControl** ctrls = 0;
+        if (checkLdapError(meth, "ldap_get_entry_controls", ldap_get_entry_controls(ldp, e, &ctrls), xsink))
+            return -1;
+        if (!ctrls)
+            return syncError("entry without a sync state control", xsink);
+        ON_BLOCK_EXIT(ldap_controls_free, ctrls);
+        LDAPControl* ctrl = ldap_control_find(LDAP_CONTROL_SYNC_STATE, ctrls, 0);
+        if (!ctrl)
+            return syncError("entry without a sync state control", xsink);
+
+        // syncStateValue ::= SEQUENCE { state ENUMERATED, entryUUID syncUUID, cookie syncCookie OPTIONAL }
+        BerElement* ber = ber_init(&ctrl->ldctl_value);
+        if (!ber) {
+            xsink->outOfMemory();
+            return -1;
+        }
+        ON_BLOCK_EXIT(ber_free, ber, 1);
+        ber_int_t st;
+        berval ubv;
+        if (ber_scanf(ber, "{em", &st, &ubv) == LBER_ERROR)
+            return syncError("invalid sync state control", xsink);
+        state = st;
+        uuid.assign(ubv.bv_val, ubv.bv_len);
+        getBerOptionalString(ber, LDAP_TAG_SYNC_COOKIE, cookie);
+        return 0;
+    }
 
-        int msgid;
-        if (checkLdapError("search", "ldap_search_ext", ldap_search_ext(ldp, bstr->empty() ? 0 : bstr->getBuffer(), scope, fstr->empty() ? 0 : fstr->getBuffer(), *attrs, (int)attrsonly, 0, 0, 0, 0, &msgid), xsink))
+    // parses a sync info intermediate response received by a content synchronization search; the lock must be held
+    /** @return 1 if the message is a sync info message, 0 if it is another intermediate response, -1 if an exception
+        was raised
+    */
+    DLLLOCAL int getSyncInfoIntern(const char* meth, LDAPMessage* msg, QoreLdapSyncInfo& info, ExceptionSink* xsink) {
+        char* oid = 0;
+        berval* data = 0;
+        if (checkLdapError(meth, "ldap_parse_intermediate", ldap_parse_intermediate(ldp, msg, &oid, &data, 0, 0), xsink))
+            return -1;
+        ON_BLOCK_EXIT(ldap_memfree, oid);
+        ON_BLOCK_EXIT(ber_bvfree, data);
+        if (!oid || strcmp(oid, LDAP_SYNC_INFO) || !data)
             return 0;
 
-        LDAPMessage* res = 0;
-        TimeoutHelper timeout(my_timeout_ms);
-
-        if (checkLdapResult("search", "ldap_search_ext", ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &res), xsink)) {
-            assert(!res);
-            return 0;
+        BerElement* ber = ber_init(data);
+        if (!ber) {
+            xsink->outOfMemory();
+            return -1;
         }
+        ON_BLOCK_EXIT(ber_free, ber, 1);
+
+        ber_len_t len;
+        info.tag = ber_peek_tag(ber, &len);
+        switch (info.tag) {
+            case LDAP_TAG_SYNC_NEW_COOKIE: {
+                berval bv;
+                if (ber_scanf(ber, "m", &bv) == LBER_ERROR)
+                    return syncError("invalid newcookie message", xsink);
+                info.cookie.assign(bv.bv_val, bv.bv_len);
+                break;
+            }
 
-        ON_BLOCK_EXIT(ldap_msgfree, res);
+            case LDAP_TAG_SYNC_REFRESH_DELETE:
+            case LDAP_TAG_SYNC_REFRESH_PRESENT:
+                if (ber_scanf(ber, "{") == LBER_ERROR)
+                    return syncError("invalid refresh message", xsink);
+                getBerOptionalString(ber, LDAP_TAG_SYNC_COOKIE, info.cookie);
+                info.refresh_done = getBerOptionalBool(ber, LDAP_TAG_REFRESHDONE, true);
+                break;
+
+            case LDAP_TAG_SYNC_ID_SET: {
+                if (ber_scanf(ber, "{") == LBER_ERROR)
+                    return syncError("invalid syncIdSet message", xsink);
+                getBerOptionalString(ber, LDAP_TAG_SYNC_COOKIE, info.cookie);
+                info.refresh_deletes = getBerOptionalBool(ber, LDAP_TAG_REFRESHDELETES, false);
+                BerVarray uuids = 0;
+                if (ber_scanf(ber, "[W]", &uuids) == LBER_ERROR)
+                    return syncError("invalid syncIdSet message", xsink);
+                for (BerVarray p = uuids; p && p->bv_val; ++p)
+                    info.uuids.push_back(std::string(p->bv_val, p->bv_len));
+                ber_bvarray_free(uuids);
+                break;
+            }
 
-        ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+            default:
+                return syncError("unknown sync info message", xsink);
+        }
+        return 1;
+    }
 
-        //printd(5, "LdapClient::search() results: %d entries: %d\n", ldap_count_messages(ldp, res), ldap_count_entries(ldp, res));
+    // parses the window, timeout, and stop_on_error options of batch operations; returns -1 if an exception was
+    // raised
+    DLLLOCAL int parseBatchOpts(const QoreHashNode* opts, const char* err, size_t& window, int& my_timeout_ms, bool& stop_on_error, ExceptionSink* xsink) const {
+        window = QORE_LDAP_BATCH_DEFAULT_WINDOW;
+        my_timeout_ms = 0;
+        stop_on_error = false;
+        if (opts) {
+            QoreValue v = opts->getKeyValue("window");
+            if (!v.isNothing()) {
+                int64 w = v.getAsBigInt();
+                if (w <= 0) {
+                    xsink->raiseException(err, "invalid 'window' value " QLLD "; expecting a value > 0", w);
+                    return -1;
+                }
+                window = (size_t)w;
+            }
+            my_timeout_ms = getMsZeroInt(opts->getKeyValue("timeout"));
+            stop_on_error = opts->getKeyValue("stop_on_error").getAsBool();
+        }
+        if (!my_timeout_ms)
+            my_timeout_ms = timeout_ms;
+        return 0;
+    }
 
-        LDAPMessage* e = ldap_first_entry(ldp, res);
-        for (int i = 0; e; ++i, e = ldap_next_entry(ldp, e)) {
-            ReferenceHolder<QoreHashNode> he(new QoreHashNode, xsink);
+    // sends the given operation without waiting for the result and returns the message ID or -1 if an exception
+    // was raised
+    DLLLOCAL int batchStart(OpHelper& oh, const QoreLdapBatchOp& bop, const char*& f, ExceptionSink* xsink) {
+        switch (bop.type) {
+            case QLO_ADD: f = "ldap_add_ext"; return addStart(oh, bop.dn, bop.attr, xsink);
+            case QLO_MODIFY: f = "ldap_modify_ext"; return modifyStart(oh, bop.dn, bop.mods, xsink);
+            case QLO_DELETE: f = "ldap_delete_ext"; return delStart(oh, bop.dn, xsink);
+            default: f = "ldap_rename"; return renameStart(oh, bop.dn, bop.newrdn, bop.newparent, bop.deleteoldrdn, xsink);
+        }
+    }
 
-            /*
-            for (LDAPMessage* msg = ldap_first_message(ldp, e); msg; msg = ldap_next_message(ldp, msg)) {
-                printd(0, "LdapClient::search() message type: %d entries: %d\n", ldap_msgtype(msg), ldap_count_entries(ldp, msg));
-                if (ldap_msgtype(msg) == LDAP_RES_SEARCH_RESULT) {
+    // sends operations back to back with at most \a window requests outstanding; the lock must be held
+    /** \a next is called to get each operation and returns 1 if an operation was returned, 0 if there are no more
+        operations, or -1 if an exception was raised; the data referenced by the operation only needs to remain
+        valid until \a next is called again.  \a done is called with the parsed result of each operation in the
+        order the operations were sent and returns false if no more operations should be sent
+
+        @return 0 for success, -1 if an exception was raised
+    */
+    template <typename N, typename D>
+    DLLLOCAL int pipelineIntern(OpHelper& oh, const char* meth, size_t window, int my_timeout_ms, N next, D done, ExceptionSink* xsink) {
+        // the message IDs of the outstanding requests in the order sent
+        std::deque<int> outstanding;
+        // abandons all outstanding requests on error
+        auto abandon = [&] () {
+            for (auto& i : outstanding)
+                removeOpIntern(i);
+            return -1;
+        };
+
+        bool stop = false;
+        while (true) {
+            while (outstanding.size() < window && !stop) {
+                QoreLdapBatchOp bop;
+                int rc = next(bop);
+                if (rc < 0)
+                    return abandon();
+                if (!rc) {
+                    stop = true;
+                    break;
                 }
+                const char* f;
+                int msgid = batchStart(oh, bop, f, xsink);
+                if (msgid < 0)
+                    return abandon();
+                oh.takeInval(registerOpIntern(msgid, meth, f, bop.type, false)->inval);
+                outstanding.push_back(msgid);
             }
-            */
-
-            BerElement* ber;
-            char* attr = ldap_first_attribute(ldp, e, &ber);
-            for (; attr; attr = ldap_next_attribute(ldp, e, ber)) {
-                struct berval** vals;
-                //printd(5, "LdapClient::search() attribute: %s\n", attr);
-
-                ReferenceHolder<> aval(xsink);
-                QoreListNode* al = 0;
-                if ((vals = ldap_get_values_len(ldp, e, attr))) {
-                    for (unsigned i = 0; vals[i]; ++i) {
-                        //printd(5, "LdapClient::search (%ld) %s\n", vals[i]->bv_len, vals[i]->bv_val );
-                        QoreStringNode *avstr = new QoreStringNode(vals[i]->bv_val, vals[i]->bv_len, QCS_UTF8);
-                        if (!i)
-                            aval = avstr;
-                        else {
-                            if (i == 1) {
-                                al = new QoreListNode(autoTypeInfo);
-                                al->push(aval.release(), xsink);
-                                aval = al;
-                            }
-                            al->push(avstr, xsink);
-                        }
-                    }
+            if (outstanding.empty())
+                return 0;
+
+            // collect the response to the oldest outstanding request
+            int msgid = outstanding.front();
+            QoreLdapPendingOp* op;
+            int rc = waitOpIntern(msgid, true, my_timeout_ms, op);
+            // internal operations are only removed by the thread that registered them
+            assert(op);
+            // each operation is recorded in the statistics; the wait phase covers the time from sending the
+            // request until the response was received
+            QoreLdapOpTimer t(stats, xsink, (qore_ldap_stat_op_e)op->type, QLP_WAIT, op->sent);
+            t.msgid = msgid;
+            if (rc <= 0) {
+                t.result = rc ? op->err : LDAP_TIMEOUT;
+                doLdapError(meth, op->f, t.result, xsink);
+                oh.traceOp(t);
+                return abandon();
+            }
+            assert(!op->msgs.empty());
+            LDAPMessage* msg = op->msgs.back();
+            op->msgs.pop_back();
+            const char* f = op->f;
+            for (auto& i : op->inval)
+                cache->invalidate(i.c_str());
+            removeOpIntern(msgid);
+            outstanding.pop_front();
+
+            t.phase(QLP_DECODE);
+            QoreLdapParseResultHelper prh(meth, f, this, msg, xsink);
+            if (!*xsink) {
+                // server result codes are returned to the caller without raising an exception
+                t.result = prh.getError();
+                t.failed = t.result != LDAP_SUCCESS;
+            }
+            oh.traceOp(t);
+            if (*xsink)
+                return abandon();
+            if (!done(prh))
+                stop = true;
+            if (*xsink)
+                return abandon();
+        }
+    }
 
-                    ber_bvecfree(vals);
-                }
+    // sends the operations in the list back to back and returns a list of result hashes
+    /** at most \a window requests are outstanding at any one time; server result codes are returned in the result
+        hashes, while local errors raise an exception
+    */
+    DLLLOCAL QoreListNode* batch(ExceptionSink* xsink, const QoreListNode& ops, const QoreHashNode* opts) {
+        size_t window;
+        int my_timeout_ms;
+        bool stop_on_error;
+        if (parseBatchOpts(opts, "LDAP-BATCH-ERROR", window, my_timeout_ms, stop_on_error, xsink))
+            return 0;
 
-                he->setKeyValue(attr, aval.release(), 0);
-                ldap_memfree(attr);
+        // validate all operations before sending any requests
+        std::vector<QoreLdapBatchOp> bv(ops.size());
+        for (size_t i = 0; i < ops.size(); ++i) {
+            QoreValue v = ops.retrieveEntry(i);
+            if (v.getType() != NT_HASH) {
+                xsink->raiseException("LDAP-BATCH-ERROR", "operation %d has type '%s'; expecting 'hash'", (int)i, v.getTypeName());
+                return 0;
             }
-            if (ber)
-                ber_free(ber, 0);
-
-            char* p = ldap_get_dn(ldp, e);
-            h->setKeyValue(p, he.release(), 0);
-            ldap_memfree(p);
+            if (bv[i].parse(*v.get<const QoreHashNode>(), i, xsink))
+                return 0;
         }
 
-        return h.release();
-    }
+        ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
+        OpHelper oh(this, "batch", xsink);
+        if (oh.lock())
+            return 0;
 
-    DLLLOCAL int add(ExceptionSink* xsink, const QoreStringNode* dn, const QoreHashNode* attr, int my_timeout_ms = 0) {
-        // convert strings to UTF-8 if necessary
-        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
-        if (*xsink)
-            return -1;
+        size_t next = 0, i = 0;
+        int rc = pipelineIntern(oh, "batch", window, my_timeout_ms, [&] (QoreLdapBatchOp& bop) -> int {
+            if (next == bv.size())
+                return 0;
+            bop = bv[next++];
+            return 1;
+        }, [&] (const QoreLdapParseResultHelper& prh) -> bool {
+            const QoreLdapBatchOp& bop = bv[i++];
+            ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+            h->setKeyValue("op", new QoreStringNode(bop.name), xsink);
+            h->setKeyValue("dn", bop.dn->stringRefSelf(), xsink);
+            int err = prh.getError();
+            h->setKeyValue("code", (int64)err, xsink);
+            if (err != LDAP_SUCCESS) {
+                h->setKeyValue("error", new QoreStringNode(ldap_err2string(err)), xsink);
+                if (prh.getText())
+                    h->setKeyValue("diagnostic", new QoreStringNode(prh.getText()), xsink);
+                if (prh.getMatched())
+                    h->setKeyValue("matched", new QoreStringNode(prh.getMatched()), xsink);
+            }
+            rv->push(h.release(), xsink);
+            return err == LDAP_SUCCESS || !stop_on_error;
+        }, xsink);
 
-        ModListHelper mods(xsink, attr);
-        if (*xsink)
-            return -1;
+        return rc ? 0 : rv.release();
+    }
 
-        AutoLocker al(m);
-        if (checkValidIntern("add", xsink))
-            return -1;
+    // reads the records of the given LDIF file and sends them with pipelined requests as they are read
+    /** only the records in flight are held in memory
+
+        @return a hash with the number of records processed, the number of records that failed, and a list of
+        hashes describing the failed records, or 0 if an exception was raised
+    */
+    DLLLOCAL QoreHashNode* importLdif(ExceptionSink* xsink, const QoreStringNode* path, const QoreHashNode* opts) {
+        size_t window;
+        int my_timeout_ms;
+        bool stop_on_error;
+        if (parseBatchOpts(opts, "LDAP-LDIF-ERROR", window, my_timeout_ms, stop_on_error, xsink))
+            return 0;
 
-        int msgid;
-        if (checkLdapError("add", "ldap_add_ext", ldap_add_ext(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), (LDAPMod**)*mods, 0, 0, &msgid), xsink))
-            return -1;
+        FILE* f = fopen(path->c_str(), "r");
+        if (!f) {
+            xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "cannot open LDIF file '%s' for reading", path->c_str());
+            return 0;
+        }
+        ON_BLOCK_EXIT(fclose, f);
+        QoreLdifReader reader(f, path->c_str());
+        QoreLdifRecord rec(xsink);
+
+        // the records in flight in the order sent: line number, operation, and UTF-8 DN
+        struct RecordInfo {
+            int line;
+            const char* op;
+            std::string dn;
+        };
+        std::deque<RecordInfo> sent;
+
+        int64 count = 0, errors = 0;
+        ReferenceHolder<QoreListNode> failed(new QoreListNode(autoTypeInfo), xsink);
+
+        OpHelper oh(this, "importLdif", xsink);
+        if (oh.lock())
+            return 0;
 
-        LDAPMessage* res = 0;
-        TimeoutHelper timeout(my_timeout_ms);
+        int rc = pipelineIntern(oh, "importLdif", window, my_timeout_ms, [&] (QoreLdapBatchOp& bop) -> int {
+            int rc = reader.next(rec, xsink);
+            if (rc <= 0)
+                return rc;
+            bop.dn = *rec.dn;
+            switch (rec.type) {
+                case QLC_ADD:
+                    bop.type = QLO_ADD;
+                    bop.name = "add";
+                    bop.attr = *rec.attr;
+                    break;
+                case QLC_DELETE:
+                    bop.type = QLO_DELETE;
+                    bop.name = "del";
+                    break;
+                case QLC_MODIFY:
+                    bop.type = QLO_MODIFY;
+                    bop.name = "modify";
+                    bop.mods = *rec.mods;
+                    break;
+                case QLC_MODRDN:
+                    bop.type = QLO_RENAME;
+                    bop.name = "rename";
+                    bop.newrdn = *rec.newrdn;
+                    bop.newparent = *rec.newsuperior;
+                    bop.deleteoldrdn = rec.deleteoldrdn;
+                    break;
+            }
+            sent.push_back({rec.line, bop.name, std::string(rec.dn->c_str(), rec.dn->size())});
+            return 1;
+        }, [&] (const QoreLdapParseResultHelper& prh) -> bool {
+            RecordInfo ri;
+            ri.line = sent.front().line;
+            ri.op = sent.front().op;
+            ri.dn.swap(sent.front().dn);
+            sent.pop_front();
+            ++count;
+            int err = prh.getError();
+            if (err == LDAP_SUCCESS)
+                return true;
+            ++errors;
+            ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+            h->setKeyValue("line", (int64)ri.line, xsink);
+            h->setKeyValue("op", new QoreStringNode(ri.op), xsink);
+            h->setKeyValue("dn", new QoreStringNode(ri.dn.data(), ri.dn.size(), QCS_UTF8), xsink);
+            h->setKeyValue("code", (int64)err, xsink);
+            h->setKeyValue("error", new QoreStringNode(ldap_err2string(err)), xsink);
+            if (prh.getText())
+                h->setKeyValue("diagnostic", new QoreStringNode(prh.getText()), xsink);
+            if (prh.getMatched())
+                h->setKeyValue("matched", new QoreStringNode(prh.getMatched()), xsink);
+            failed->push(h.release(), xsink);
+            return !stop_on_error;
+        }, xsink);
+        if (rc)
+            return 0;
 
-        if (checkLdapResult("add", "ldap_add_ext", ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &res), xsink)) {
-            assert(!res);
-            return -1;
-        }
+        QoreHashNode* h = new QoreHashNode;
+        h->setKeyValue("count", count, xsink);
+        h->setKeyValue("errors", errors, xsink);
+        h->setKeyValue("failed", failed.release(), xsink);
+        return h;
+    }
 
-        return checkFreeResult("add", "ldap_add_ext", res, xsink);
+    // appends the given search result entry to the string as an LDIF record; the lock must be held
+    DLLLOCAL void formatLdifIntern(LDAPMessage* e, std::string& out) {
+        QoreLdapEntryDecoder d(ldp, e);
+        QoreLdifWriter::addLine(out, "dn", d.getDn().bv_val, d.getDn().bv_len);
+        while (d.next()) {
+            const berval* vals = d.getValues();
+            for (const berval* v = vals; v && v->bv_val; ++v)
+                QoreLdifWriter::addLine(out, d.getName(), v->bv_val, v->bv_len);
+        }
+        out += '\n';
     }
 
-    DLLLOCAL int modify(ExceptionSink* xsink, const QoreStringNode* dn, const QoreListNode* ml, int my_timeout_ms = 0) {
-        // convert strings to UTF-8 if necessary
-        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
-        if (*xsink)
+    // writes the entries returned by the given search to an LDIF file as they are received and returns the number
+    // of entries written or -1 if an exception was raised
+    /** entries are written directly from the received values without creating intermediate hashes
+    */
+    DLLLOCAL int64 exportLdif(ExceptionSink* xsink, const QoreHashNode& h, const QoreStringNode* path, int my_timeout_ms = 0) {
+        QoreLdapSearchStream ss(h, xsink);
+        if (ss.parse())
             return -1;
 
-        ModListHelper mods(xsink, ml);
-        if (*xsink)
+        FILE* f = fopen(path->c_str(), "w");
+        if (!f) {
+            xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "cannot open LDIF file '%s' for writing", path->c_str());
             return -1;
+        }
+        ON_BLOCK_EXIT(fclose, f);
 
-        AutoLocker al(m);
-        if (checkValidIntern("modify", xsink))
-            return -1;
+        auto write = [&] (const std::string& str) -> int {
+            if (fwrite(str.data(), 1, str.size(), f) != str.size()) {
+                xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "error writing LDIF file '%s'", path->c_str());
+                return -1;
+            }
+            return 0;
+        };
 
-        int msgid;
-        if (checkLdapError("modify", "ldap_modify_ext", ldap_modify_ext(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), (LDAPMod**)*mods, 0, 0, &msgid), xsink))
+        if (write("version: 1\n\n") || searchStream(xsink, ss, "exportLdif"))
             return -1;
 
-        LDAPMessage* res = 0;
-        TimeoutHelper timeout(my_timeout_ms);
+        int64 count = 0;
+        std::string out;
+        while (true) {
+            out.clear();
+            int rc = searchNextIntern(xsink, ss, "exportLdif", my_timeout_ms, [&] (LDAPMessage* e) -> int {
+                formatLdifIntern(e, out);
+                return 0;
+            });
+            if (rc < 0) {
+                searchEnd(ss, xsink);
+                return -1;
+            }
+            if (!rc)
+                break;
+            // the entry is written without the lock held
+            if (write(out)) {
+                searchEnd(ss, xsink);
+                return -1;
+            }
+            ++count;
+        }
 
-        if (checkLdapResult("modify", "ldap_modify_ext", ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &res), xsink)) {
-            assert(!res);
+        if (fflush(f)) {
+            xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "error writing LDIF file '%s'", path->c_str());
             return -1;
         }
+        return count;
+    }
 
-        return checkFreeResult("modify", "ldap_modify_ext", res, xsink);
+    // reads all records of the given LDIF file without a server and returns a list of hashes describing them or 0
+    // if an exception was raised
+    DLLLOCAL static QoreListNode* readLdif(ExceptionSink* xsink, const QoreStringNode* path) {
+        FILE* f = fopen(path->c_str(), "r");
+        if (!f) {
+            xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "cannot open LDIF file '%s' for reading", path->c_str());
+            return 0;
+        }
+        ON_BLOCK_EXIT(fclose, f);
+        QoreLdifReader reader(f, path->c_str());
+        QoreLdifRecord rec(xsink);
+
+        ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
+        while (true) {
+            int rc = reader.next(rec, xsink);
+            if (rc < 0)
+                return 0;
+            if (!rc)
+                break;
+            rv->push(rec.getHash(xsink), xsink);
+        }
+        return rv.release();
     }
 
-    DLLLOCAL int del(ExceptionSink* xsink, const QoreStringNode* dn, int my_timeout_ms = 0) {
-        // convert strings to UTF-8 if necessary
-        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
+    // appends a line for each value of the given attribute; returns -1 if an exception was raised
+    DLLLOCAL static int addLdifValue(std::string& out, const char* name, QoreValue v, ExceptionSink* xsink) {
+        if (v.getType() == NT_LIST) {
+            ConstListIterator li(v.get<const QoreListNode>());
+            while (li.next()) {
+                if (addLdifValue(out, name, li.getValue(), xsink))
+                    return -1;
+            }
+            return 0;
+        }
+        if (v.getType() == NT_BINARY) {
+            const BinaryNode* b = v.get<const BinaryNode>();
+            QoreLdifWriter::addLine(out, name, (const char*)b->getPtr(), b->size());
+            return 0;
+        }
+        QoreStringValueHelper str(v, QCS_UTF8, xsink);
         if (*xsink)
             return -1;
+        QoreLdifWriter::addLine(out, name, str->c_str(), str->size());
+        return 0;
+    }
 
-        AutoLocker al(m);
-        if (checkValidIntern("del", xsink))
+    // writes the given entries to an LDIF file without a server and returns the number of entries written or -1 if
+    // an exception was raised
+    /** each entry is a hash with \c dn and \c attributes keys as returned by searches in list format
+    */
+    DLLLOCAL static int64 writeLdif(ExceptionSink* xsink, const QoreListNode* entries, const QoreStringNode* path) {
+        FILE* f = fopen(path->c_str(), "w");
+        if (!f) {
+            xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "cannot open LDIF file '%s' for writing", path->c_str());
             return -1;
+        }
+        ON_BLOCK_EXIT(fclose, f);
+
+        std::string out = "version: 1\n\n";
+        int64 count = 0;
+        ConstListIterator li(entries);
+        while (li.next()) {
+            QoreValue v = li.getValue();
+            if (v.getType() != NT_HASH) {
+                xsink->raiseException("LDAP-LDIF-ERROR", "entry %d has type '%s'; expecting 'hash'", (int)li.index() + 1, v.getTypeName());
+                return -1;
+            }
+            const QoreHashNode* h = v.get<const QoreHashNode>();
+            const QoreStringNode* dn = check_hash_key<QoreStringNode>(xsink, *h, "dn", "LDAP-LDIF-ERROR");
+            if (*xsink)
+                return -1;
+            if (!dn) {
+                xsink->raiseException("LDAP-LDIF-ERROR", "entry %d has no 'dn' key", (int)li.index() + 1);
+                return -1;
+            }
+            const QoreHashNode* attrs = check_hash_key<QoreHashNode>(xsink, *h, "attributes", "LDAP-LDIF-ERROR");
+            if (*xsink)
+                return -1;
 
-        int msgid;
-        if (checkLdapError("del", "ldap_delete_ext", ldap_delete_ext(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), 0, 0, &msgid), xsink))
-            return -1;
+            if (addLdifValue(out, "dn", dn, xsink))
+                return -1;
+            if (attrs) {
+                ConstHashIterator hi(attrs);
+                while (hi.next()) {
+                    if (addLdifValue(out, hi.getKey(), hi.get(), xsink))
+                        return -1;
+                }
+            }
+            out += '\n';
+            ++count;
 
-        LDAPMessage* res = 0;
-        TimeoutHelper timeout(my_timeout_ms);
+            if (fwrite(out.data(), 1, out.size(), f) != out.size()) {
+                xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "error writing LDIF file '%s'", path->c_str());
+                return -1;
+            }
+            out.clear();
+        }
 
-        if (checkLdapResult("del", "ldap_delete_ext", ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &res), xsink)) {
-            assert(!res);
+        if (out.size() && fwrite(out.data(), 1, out.size(), f) != out.size()) {
+            xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "error writing LDIF file '%s'", path->c_str());
+            return -1;
+        }
+        if (fflush(f)) {
+            xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "error writing LDIF file '%s'", path->c_str());
             return -1;
         }
+        return count;
+    }
 
-        return checkFreeResult("del", "ldap_delete_ext", res, xsink);
+    // executes a search and calls the given callback with each entry as it is received
+    /** the callback is called without the session lock held; the search is abandoned if the callback returns
+        False
 
-        return 0;
-    }
+        @return the number of entries passed to the callback
+    */
+    DLLLOCAL int64 searchCallback(ExceptionSink* xsink, const QoreHashNode& h, const ResolvedCallReferenceNode* cb, int my_timeout_ms = 0) {
+        QoreLdapSearchStream ss(h, xsink);
+        if (ss.parse() || searchStream(xsink, ss))
+            return 0;
 
-    DLLLOCAL bool compare(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* attr, const QoreListNode* vl, int my_timeout_ms = 0) {
-        // convert strings to UTF-8 if necessary
-        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
-        if (*xsink)
-            return -1;
+        int64 count = 0;
+        while (true) {
+            ReferenceHolder<QoreHashNode> entry(xsink);
+            if (searchNext(xsink, ss, my_timeout_ms, entry) <= 0)
+                break;
 
-        QoreStringValueHelper attrstr(attr, QCS_UTF8, xsink);
-        if (*xsink)
-            return -1;
+            ReferenceHolder<QoreListNode> args(new QoreListNode(autoTypeInfo), xsink);
+            args->push(entry->getKeyValue("dn").refSelf(), xsink);
+            args->push(entry->getKeyValue("attributes").refSelf(), xsink);
+            ++count;
 
-        BervalListHelper bval(vl, xsink);
-        if (*xsink)
-            return -1;
+            ValueHolder rv(cb->execValue(*args, xsink), xsink);
+            if (*xsink)
+                break;
+            // stop if the callback explicitly returns False
+            if (rv->getType() == NT_BOOLEAN && !rv->getAsBool())
+                break;
+        }
 
-        AutoLocker al(m);
-        if (checkValidIntern("compare", xsink))
-            return -1;
+        // abandon the search if it's not complete
+        searchEnd(ss, xsink);
+        return count;
+    }
 
-        int msgid;
-        if (checkLdapError("compare", "ldap_compare_ext", ldap_compare_ext(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), attrstr->empty() ? 0 : attrstr->getBuffer(), **bval, 0, 0, &msgid), xsink))
-            return -1;
+    // reports changes to the entries matching the search to the callback as they are made
+    /** the search is executed on a new session bound with the same identity so that this session remains available
+
+        @return the number of events reported or -1 if an exception was raised
+    */
+    DLLLOCAL int64 watch(ExceptionSink* xsink, const QoreHashNode& h, const ResolvedCallReferenceNode* cb, const QoreHashNode* opts) {
+        bool sync = false;
+        int change_types = LDAP_CONTROL_PERSIST_ENTRY_CHANGE_ADD | LDAP_CONTROL_PERSIST_ENTRY_CHANGE_DELETE
+            | LDAP_CONTROL_PERSIST_ENTRY_CHANGE_MODIFY | LDAP_CONTROL_PERSIST_ENTRY_CHANGE_RENAME;
+        int idle_ms = 0;
+        if (opts) {
+            QoreValue v = opts->getKeyValue("control");
+            if (!v.isNothing()) {
+                QoreStringValueHelper str(v, QCS_UTF8, xsink);
+                if (*xsink)
+                    return -1;
+                if (!strcmp(str->c_str(), "sync"))
+                    sync = true;
+                else if (strcmp(str->c_str(), "psearch")) {
+                    xsink->raiseException("LDAP-WATCH-ERROR", "invalid 'control' value '%s'; expecting 'psearch' or 'sync'", str->c_str());
+                    return -1;
+                }
+            }
 
-        LDAPMessage* res = 0;
-        TimeoutHelper timeout(my_timeout_ms);
+            v = opts->getKeyValue("changes");
+            if (!v.isNothing()) {
+                ReferenceHolder<QoreListNode> l(xsink);
+                if (v.getType() == NT_LIST)
+                    l = v.get<QoreListNode>()->listRefSelf();
+                else {
+                    l = new QoreListNode(autoTypeInfo);
+                    l->push(v.refSelf(), xsink);
+                }
+                change_types = 0;
+                ConstListIterator li(*l);
+                while (li.next()) {
+                    QoreStringValueHelper str(li.getValue(), QCS_UTF8, xsink);
+                    if (*xsink)
+                        return -1;
+                    int ct = getChangeType(str->c_str());
+                    if (!ct) {
+                        xsink->raiseException("LDAP-WATCH-ERROR", "invalid change type '%s'; expecting 'add', 'delete', 'modify', or 'moddn'", str->c_str());
+                        return -1;
+                    }
+                    change_types |= ct;
+                }
+            }
 
-        if (checkLdapResult("compare", "ldap_compare_ext", ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &res), xsink)) {
-            assert(!res);
-            return false;
+            idle_ms = getMsZeroInt(opts->getKeyValue("timeout"));
         }
 
-        QoreLdapParseResultHelper prh("compare", "ldap_compare_ext", this, res, xsink);
-        if (*xsink)
+        QoreLdapSearchStream ss(h, xsink);
+        if (ss.parse() || prepareSearch(ss.sp, xsink))
             return -1;
 
-        int rc = prh.getError();
-        if (rc == LDAP_COMPARE_TRUE)
-            return true;
-        if (rc == LDAP_COMPARE_FALSE)
-            return false;
-
-        prh.check();
-        return false;
+        // the search runs indefinitely, so it's executed on a dedicated session
+        QoreLdapClient* wl = new QoreLdapClient(*this, xsink);
+        int64 rv = *xsink ? -1 : wl->watchIntern(xsink, ss, cb, sync, change_types, idle_ms);
+        wl->destructor(xsink);
+        wl->deref(xsink);
+        return rv;
     }
 
-    DLLLOCAL int rename(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* newrdn, const QoreStringNode* newparent, bool deleteoldrdn = true, int my_timeout_ms = 0) {
-        // convert strings to UTF-8 if necessary
-        QoreStringValueHelper dnstr(dn, QCS_UTF8, xsink);
-        if (*xsink)
-            return -1;
+    // waits for the given asynchronous operation to complete and returns its result
+    DLLLOCAL QoreValue wait(ExceptionSink* xsink, int64 handle, int my_timeout_ms = 0) {
+        OpHelper oh(this, "wait", xsink);
+        if (oh.lock())
+            return QoreValue();
+
+        QoreLdapPendingOp* op = getAsyncOpIntern("wait", handle, xsink);
+        if (!op)
+            return QoreValue();
+
+        // operations that failed when the session context was reinitialized are already complete
+        int rc = 1;
+        if (!op->done) {
+            // the operation is claimed so that it cannot be retrieved or abandoned by another thread while the lock
+            // is released
+            op->claimed = true;
+            rc = waitOpIntern(getMsgidIntern(handle), true, my_timeout_ms ? my_timeout_ms : timeout_ms, op);
+            assert(op);
+            op->claimed = false;
+        }
 
-        QoreStringValueHelper newrdnstr(newrdn, QCS_UTF8, xsink);
-        if (*xsink)
-            return -1;
+        // a timeout leaves the operation pending so that it can be waited for again
+        if (!rc) {
+            doLdapError("wait", op->f, LDAP_TIMEOUT, xsink);
+            return QoreValue();
+        }
 
-        QoreStringValueHelper newparentstr(newparent, QCS_UTF8, xsink);
-        if (*xsink)
-            return -1;
+        return completeAsyncIntern(oh, handle, op, xsink);
+    }
 
-        AutoLocker al(m);
-        if (checkValidIntern("rename", xsink))
-            return -1;
+    // waits for any of the given asynchronous operations to complete; returns 0 on timeout
+    DLLLOCAL QoreHashNode* waitAny(ExceptionSink* xsink, const QoreListNode* handles, int my_timeout_ms = 0) {
+        OpHelper oh(this, "waitAny", xsink);
+        if (oh.lock())
+            return 0;
 
-        //printd(5, "LdapClient::rename() dn: '%s' newrdn: '%s' newparent: '%s' deleteoldrdn: %d\n", dnstr->getBuffer(), newrdnstr->getBuffer(), newparentstr->getBuffer(), (int)deleteoldrdn);
+        std::vector<std::pair<int64, QoreLdapPendingOp*>> ops;
+        ConstListIterator li(handles);
+        while (li.next()) {
+            int64 handle = li.getValue().getAsBigInt();
+            QoreLdapPendingOp* op = getAsyncOpIntern("waitAny", handle, xsink);
+            if (!op)
+                return 0;
+            ops.push_back(std::make_pair(handle, op));
+        }
 
-        int msgid;
-        if (checkLdapError("rename", "ldap_rename", ldap_rename(ldp, dnstr->empty() ? 0 : dnstr->getBuffer(), newrdnstr->empty() ? 0 : newrdnstr->getBuffer(), newparentstr->empty() ? 0 : newparentstr->getBuffer(), (int)deleteoldrdn, 0, 0, &msgid), xsink))
-            return -1;
+        // the operations are claimed so that they cannot be retrieved or abandoned by another thread while the lock
+        // is released; they are claimed after all handles have been checked, so that a handle may be given more
+        // than once
+        for (auto& i : ops)
+            i.second->claimed = true;
+
+        if (!my_timeout_ms)
+            my_timeout_ms = timeout_ms;
+        int64 start = q_clock_getmicros();
+        while (true) {
+            for (auto& i : ops) {
+                if (i.second->done) {
+                    for (auto& j : ops)
+                        j.second->claimed = false;
+                    ExceptionSink xsink2;
+                    ValueHolder result(completeAsyncIntern(oh, i.first, i.second, &xsink2), xsink);
+                    if (xsink2) {
+                        // the operation has been removed, so its handle is given in the exception argument so that
+                        // the caller can stop waiting for it
+                        QoreStringValueHelper err(xsink2.getExceptionErr());
+                        QoreStringValueHelper desc(xsink2.getExceptionDesc());
+                        xsink2.clear();
+                        QoreHashNode* arg = new QoreHashNode;
+                        arg->setKeyValue("handle", i.first, xsink);
+                        xsink->raiseExceptionArg(err->c_str(), arg, new QoreStringNode(desc->c_str()));
+                        return 0;
+                    }
+                    ReferenceHolder<QoreHashNode> rv(new QoreHashNode, xsink);
+                    rv->setKeyValue("handle", i.first, xsink);
+                    rv->setKeyValue("result", result.release(), xsink);
+                    return rv.release();
+                }
+            }
 
-        LDAPMessage* res = 0;
-        TimeoutHelper timeout(my_timeout_ms);
+            int remaining = my_timeout_ms - (int)((q_clock_getmicros() - start) / 1000);
+            if (remaining <= 0) {
+                for (auto& i : ops)
+                    i.second->claimed = false;
+                return 0;
+            }
 
-        if (checkLdapResult("rename", "ldap_rename", ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &res), xsink)) {
-            assert(!res);
-            return -1;
+            if (!reading)
+                readIntern(remaining);
+            else
+                pcond.wait(&m, remaining);
         }
-
-        return checkFreeResult("rename", "ldap_rename", res, xsink);
     }
 
-    DLLLOCAL int passwd(ExceptionSink* xsink, const QoreStringNode* dn, const QoreStringNode* op, const QoreStringNode* np, int my_timeout_ms = 0) {
-        // convert strings to UTF-8 if necessary
-        QoreStringBervalHelper dnstr(dn, xsink);
-        if (*xsink)
-            return -1;
-
-        QoreStringBervalHelper opstr(op, xsink);
-        if (*xsink)
-            return -1;
-
-        QoreStringBervalHelper npstr(np, xsink);
-        if (*xsink)
-            return -1;
+    // reads all available responses without blocking and returns the handles of completed asynchronous operations
+    DLLLOCAL QoreListNode* poll(ExceptionSink* xsink) {
+        OpHelper oh(this, "poll", xsink);
+        if (oh.lock())
+            return 0;
 
-        AutoLocker al(m);
-        if (checkValidIntern("passwd", xsink))
-            return -1;
+        // if another thread is reading responses, then it routes them for us
+        if (!reading) {
+            while (readIntern(0) > 0) {
+            }
+        }
 
-        //printd(5, "LdapClient::passwd() dn: '%s' old: '%s' new: '%s'\n", dnstr->getBuffer(), opstr->getBuffer(), npstr->getBuffer());
+        ReferenceHolder<QoreListNode> rv(new QoreListNode(bigIntTypeInfo), xsink);
+        for (auto& i : pending) {
+            if (i.second->async && i.second->done)
+                rv->push(getHandleIntern(i.first), xsink);
+        }
+        // operations that failed when the session context was reinitialized
+        for (auto& i : orphans)
+            rv->push(i.first, xsink);
+        return rv.release();
+    }
 
-        int msgid;
-        if (checkLdapError("passwd", "ldap_passwd", ldap_passwd(ldp, &dnstr, &opstr, &npstr, 0, 0, &msgid), xsink))
+    // abandons the given asynchronous operation
+    DLLLOCAL int abandon(ExceptionSink* xsink, int64 handle) {
+        OpHelper oh(this, "abandon", xsink);
+        if (oh.lock())
             return -1;
 
-        LDAPMessage* res = 0;
-        TimeoutHelper timeout(my_timeout_ms);
-
-        if (checkLdapResult("passwd", "ldap_passwd", ldap_result(ldp, msgid, LDAP_MSG_ALL, my_timeout_ms ? &timeout : 0, &res), xsink)) {
-            assert(!res);
+        if (!getAsyncOpIntern("abandon", handle, xsink))
             return -1;
-        }
+        removeAsyncOpIntern(handle);
+        return 0;
+    }
 
-        return checkFreeResult("passwd", "ldap_passwd", res, xsink);
+    // returns true if the result code of the last operation shows that the connection was lost
+    DLLLOCAL bool isConnectionDown() {
+        AutoLocker al(m);
+        return isConnectionDownIntern();
     }
 
     DLLLOCAL QoreStringNode* getUriStr() const {
+        // the URI changes when the session is reconnected to another server
+        AutoLocker al(m);
         assert(uri);
         return uri->stringRefSelf();
     }
@@ -0,0 +1,530 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreLdapClientPool.h
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_QORELDAPCLIENTPOOL_H
+
+#define _QORE_QORELDAPCLIENTPOOL_H
+
+#include "QoreLdapClient.h"
+
+#include <deque>
+#include <vector>
+
+// default minimum number of sessions in the pool
+#define QORE_LDAP_POOL_DEFAULT_MIN 1
+// default maximum number of sessions in the pool
+#define QORE_LDAP_POOL_DEFAULT_MAX 10
+// default idle timeout in milliseconds before sessions above the minimum are closed
+#define QORE_LDAP_POOL_DEFAULT_IDLE_TIMEOUT_MS 300000
+
+// the c++ object
+class QoreLdapClientPool : public AbstractPrivateData {
+protected:
+    // an idle session
+    struct IdleSession {
+        QoreLdapClient* l;
+        // the time the session was returned to the pool in microseconds
+        int64 last_used;
+    };
+
+    typedef std::deque<IdleSession> idle_list_t;
+    typedef std::vector<QoreLdapClient*> client_vec_t;
+
+    // mutual-exclusion lock
+    mutable QoreThreadLock m;
+    // signaled when a session is returned to the pool
+    QoreCondition cond;
+    // saved URI
+    QoreStringNode* uri;
+    // saved options for new sessions
+    QoreHashNode* opts;
+    // idle sessions; the most recently used sessions are at the back
+    idle_list_t idle;
+    // minimum and maximum number of sessions
+    unsigned min, max;
+    // total number of sessions, including sessions in use and sessions being created
+    unsigned total;
+    // number of threads waiting for a session
+    unsigned waiting;
+    // idle timeout in ms; 0 = never close idle sessions
+    int idle_timeout_ms;
+    // the maximum time to wait for a free session in ms; 0 = wait forever
+    int wait_timeout_ms;
+    // the search result cache shared by all sessions, if any
+    std::shared_ptr<QoreLdapSearchCache> cache;
+    // the servers shared by all sessions for server selection, if more than one is configured
+    std::shared_ptr<QoreLdapServerSet> servers;
+    // set to false when the pool is destroyed
+    bool valid;
+    // sessions are connected when first used instead of when they are created
+    bool lazy = false;
+
+    // a session being connected in a background thread
+    struct ConnectJob {
+        QoreLdapClient* l;
+        ExceptionSink xsink;
+        // the state shared by all jobs
+        QoreThreadLock* m;
+        QoreCondition* cond;
+        unsigned* remaining;
+    };
+
+    DLLLOCAL static void destroySession(QoreLdapClient* l, ExceptionSink* xsink) {
+        l->destructor(xsink);
+        l->deref(xsink);
+    }
+
+    // returns a new session or 0 if an exception was raised; if \a defer_connect is true, then the session is not
+    // connected
+    DLLLOCAL static QoreLdapClient* newSession(const QoreStringNode* u, const QoreHashNode* o, std::shared_ptr<QoreLdapSearchCache> c, std::shared_ptr<QoreLdapServerSet> s, ExceptionSink* xsink, bool defer_connect = false) {
+        // server health is tracked for all sessions together
+        QoreLdapClient* l = new QoreLdapClient(u, o, xsink, s, defer_connect);
+        if (*xsink) {
+            destroySession(l, xsink);
+            return 0;
+        }
+        // writes on any session invalidate results cached by all sessions
+        if (c)
+            l->setSearchCache(c);
+        return l;
+    }
+
+    // removes sessions idle longer than the idle timeout while the pool is above its minimum size; lock must be held
+    DLLLOCAL void getExpiredIntern(client_vec_t& expired) {
+        if (!idle_timeout_ms)
+            return;
+
+        int64 cutoff = q_clock_getmicros() - ((int64)idle_timeout_ms * 1000);
+        while (!idle.empty() && total > min && idle.front().last_used < cutoff) {
+            expired.push_back(idle.front().l);
+            idle.pop_front();
+            --total;
+        }
+    }
+
+    DLLLOCAL static void destroySessions(const client_vec_t& cv, ExceptionSink* xsink) {
+        for (auto& i : cv)
+            destroySession(i, xsink);
+    }
+
+    DLLLOCAL static void connectThread(ExceptionSink* xsink, void* arg) {
+        ConnectJob* job = reinterpret_cast<ConnectJob*>(arg);
+        job->l->connect(&job->xsink);
+        AutoLocker al(job->m);
+        if (!--*job->remaining)
+            job->cond->signal();
+    }
+
+    // connects the given sessions in parallel, each in its own thread; returns the number of sessions connected
+    /** sessions that could not be connected are set to 0 in the list, and the exception for the first one is
+        raised
+    */
+    DLLLOCAL static unsigned connectSessions(client_vec_t& cv, ExceptionSink* xsink) {
+        QoreThreadLock jm;
+        QoreCondition jcond;
+        unsigned remaining = 0;
+
+        std::vector<ConnectJob> jobs(cv.size());
+        for (size_t i = 0; i < cv.size(); ++i) {
+            ConnectJob& job = jobs[i];
+            job.l = cv[i];
+            job.m = &jm;
+            job.cond = &jcond;
+            job.remaining = &remaining;
+        }
+
+        // the first session is connected in this thread while the others are connected in background threads
+        for (size_t i = 1; i < jobs.size(); ++i) {
+            {
+                AutoLocker al(jm);
+                ++remaining;
+            }
+            ExceptionSink start_xsink;
+            if (q_start_thread(&start_xsink, connectThread, &jobs[i]) < 0) {
+                // the session is connected in this thread if no thread could be started
+                start_xsink.clear();
+                connectThread(nullptr, &jobs[i]);
+            }
+        }
+        if (!jobs.empty())
+            jobs[0].l->connect(&jobs[0].xsink);
+
+        {
+            AutoLocker al(jm);
+            while (remaining)
+                jcond.wait(&jm);
+        }
+
+        unsigned rv = 0;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            if (!jobs[i].xsink) {
+                ++rv;
+                continue;
+            }
+            if (!*xsink)
+                xsink->assimilate(jobs[i].xsink);
+            else
+                jobs[i].xsink.clear();
+            destroySession(cv[i], xsink);
+            cv[i] = 0;
+        }
+        return rv;
+    }
+
+public:
+    DLLLOCAL QoreLdapClientPool(const QoreStringNode* uristr, const QoreHashNode* opth, ExceptionSink* xsink) : uri(uristr->stringRefSelf()), opts(opth ? opth->hashRefSelf() : 0), min(QORE_LDAP_POOL_DEFAULT_MIN), max(QORE_LDAP_POOL_DEFAULT_MAX), total(0), waiting(0), idle_timeout_ms(QORE_LDAP_POOL_DEFAULT_IDLE_TIMEOUT_MS), wait_timeout_ms(0), valid(true) {
+        if (opth) {
+            QoreValue p = opth->getKeyValue("min");
+            if (!p.isNothing()) {
+                int64 i = p.getAsBigInt();
+                if (i < 0) {
+                    xsink->raiseException("LDAP-POOL-ERROR", "invalid 'min' value " QLLD "; expecting a value >= 0", i);
+                    return;
+                }
+                min = (unsigned)i;
+            }
+
+            p = opth->getKeyValue("max");
+            if (!p.isNothing()) {
+                int64 i = p.getAsBigInt();
+                if (i <= 0) {
+                    xsink->raiseException("LDAP-POOL-ERROR", "invalid 'max' value " QLLD "; expecting a value > 0", i);
+                    return;
+                }
+                max = (unsigned)i;
+            }
+            else if (min > max)
+                max = min;
+
+            if (min > max) {
+                xsink->raiseException("LDAP-POOL-ERROR", "'min' value %d is greater than 'max' value %d", min, max);
+                return;
+            }
+
+            p = opth->getKeyValue("idle_timeout");
+            if (!p.isNothing())
+                idle_timeout_ms = getMsZeroInt(p);
+
+            wait_timeout_ms = getMsZeroInt(opth->getKeyValue("wait_timeout"));
+
+            cache = QoreLdapSearchCache::create(opth, xsink);
+            if (*xsink)
+                return;
+
+            lazy = opth->getKeyValue("lazy_connect").getAsBool();
+        }
+
+        servers = QoreLdapServerSet::create(*uristr, opth, xsink);
+        if (*xsink)
+            return;
+
+        // create the minimum number of sessions and connect them in parallel
+        client_vec_t cv;
+        for (unsigned i = 0; i < min; ++i) {
+            QoreLdapClient* l = newSession(uri, opts, cache, servers, xsink, true);
+            if (!l)
+                break;
+            idle.push_back({l, q_clock_getmicros()});
+            ++total;
+            cv.push_back(l);
+        }
+        if (*xsink || lazy)
+            return;
+
+        // the idle list is destroyed by the destructor if a session cannot be connected
+        idle.clear();
+        total = 0;
+        unsigned n = connectSessions(cv, xsink);
+        for (auto& i : cv) {
+            if (i)
+                idle.push_back({i, q_clock_getmicros()});
+        }
+        total = n;
+    }
+
+    DLLLOCAL QoreLdapClientPool(const QoreLdapClientPool& old, ExceptionSink* xsink) : QoreLdapClientPool(old.uri, old.opts, xsink) {
+    }
+
+    DLLLOCAL ~QoreLdapClientPool() {
+        assert(idle.empty());
+        assert(!uri);
+        assert(!opts);
+    }
+
+    DLLLOCAL int destructor(ExceptionSink* xsink) {
+        client_vec_t cv;
+        QoreStringNode* u;
+        QoreHashNode* o;
+        {
+            AutoLocker al(m);
+            valid = false;
+            // wake up any waiting threads so they can exit with an exception
+            if (waiting)
+                cond.broadcast();
+            for (auto& i : idle)
+                cv.push_back(i.l);
+            total -= idle.size();
+            idle.clear();
+            u = uri;
+            uri = 0;
+            o = opts;
+            opts = 0;
+        }
+        // sessions still in use are destroyed when they are released
+        destroySessions(cv, xsink);
+
+        if (u)
+            u->deref();
+        if (o)
+            o->deref(xsink);
+
+        return 0;
+    }
+
+    // acquires a session and returns any expired idle sessions to be destroyed without the lock held
+    DLLLOCAL QoreLdapClient* acquireIntern(const char* meth, client_vec_t& expired, ExceptionSink* xsink) {
+        int64 start = wait_timeout_ms ? q_clock_getmicros() : 0;
+
+        SafeLocker sl(&m);
+        while (true) {
+            if (!valid) {
+                xsink->raiseException("LDAP-POOL-ERROR", "cannot execute LdapClientPool::%s(); the LdapClientPool object has been destroyed", meth);
+                return 0;
+            }
+
+            getExpiredIntern(expired);
+
+            // reuse the most recently used session to keep the others eligible for idle eviction
+            if (!idle.empty()) {
+                QoreLdapClient* l = idle.back().l;
+                idle.pop_back();
+                return l;
+            }
+
+            if (total < max) {
+                ++total;
+                // the URI and options could be cleared by the destructor while the lock is released
+                ReferenceHolder<QoreStringNode> u(uri->stringRefSelf(), xsink);
+                ReferenceHolder<QoreHashNode> o(opts ? opts->hashRefSelf() : nullptr, xsink);
+                sl.unlock();
+                QoreLdapClient* l = newSession(*u, *o, cache, servers, xsink);
+                if (!l) {
+                    sl.lock();
+                    --total;
+                    if (waiting)
+                        cond.signal();
+                }
+                return l;
+            }
+
+            ++waiting;
+            int rc;
+            if (wait_timeout_ms) {
+                int remaining = wait_timeout_ms - (int)((q_clock_getmicros() - start) / 1000);
+                rc = remaining > 0 ? cond.wait(&m, remaining) : -1;
+            }
+            else
+                rc = cond.wait(&m);
+            --waiting;
+
+            if (rc && idle.empty() && valid) {
+                xsink->raiseException("LDAP-POOL-TIMEOUT", "timed out waiting %d ms for a free session in LdapClientPool::%s(); all %d session(s) are in use", wait_timeout_ms, meth, max);
+                return 0;
+            }
+        }
+    }
+
+    // opens up to the given number of new sessions in parallel, within the maximum size of the pool, and returns
+    // the number of sessions opened
+    /** the sessions are connected even if the \c lazy_connect option is set
+    */
+    DLLLOCAL int warm(unsigned count, ExceptionSink* xsink) {
+        ReferenceHolder<QoreStringNode> u(xsink);
+        ReferenceHolder<QoreHashNode> o(xsink);
+        {
+            AutoLocker al(m);
+            if (!valid) {
+                xsink->raiseException("LDAP-POOL-ERROR", "cannot execute LdapClientPool::warm(); the LdapClientPool object has been destroyed");
+                return 0;
+            }
+            if (count > max - total)
+                count = max - total;
+            if (!count)
+                return 0;
+            // the sessions are counted while they are being created
+            total += count;
+            u = uri->stringRefSelf();
+            o = opts ? opts->hashRefSelf() : nullptr;
+        }
+
+        client_vec_t cv;
+        for (unsigned i = 0; i < count; ++i) {
+            QoreLdapClient* l = newSession(*u, *o, cache, servers, xsink, true);
+            if (!l)
+                break;
+            cv.push_back(l);
+        }
+        unsigned n = 0;
+        if (*xsink) {
+            destroySessions(cv, xsink);
+            cv.clear();
+        }
+        else
+            n = connectSessions(cv, xsink);
+
+        client_vec_t expired;
+        {
+            AutoLocker al(m);
+            total -= count - n;
+            for (auto& i : cv) {
+                if (!i)
+                    continue;
+                if (valid)
+                    idle.push_back({i, q_clock_getmicros()});
+                else {
+                    --total;
+                    expired.push_back(i);
+                }
+            }
+            if (waiting)
+                cond.broadcast();
+        }
+        destroySessions(expired, xsink);
+        return (int)n;
+    }
+
+    //! closes sessions idle longer than the idle timeout while the pool is above its minimum size
+    /** idle sessions are otherwise only closed when sessions are acquired or released
+
+        @return the number of sessions closed
+    */
+    DLLLOCAL int expire(ExceptionSink* xsink) {
+        client_vec_t expired;
+        {
+            AutoLocker al(m);
+            if (!valid) {
+                xsink->raiseException("LDAP-POOL-ERROR", "cannot execute LdapClientPool::expire(); the LdapClientPool object has been destroyed");
+                return 0;
+            }
+            getExpiredIntern(expired);
+        }
+        destroySessions(expired, xsink);
+        return (int)expired.size();
+    }
+
+    //! acquires a session from the pool; returns 0 if an exception was raised
+    DLLLOCAL QoreLdapClient* acquire(const char* meth, ExceptionSink* xsink) {
+        client_vec_t expired;
+        QoreLdapClient* l = acquireIntern(meth, expired, xsink);
+        destroySessions(expired, xsink);
+        return l;
+    }
+
+    //! returns a session to the pool
+    /** sessions whose connection was lost are destroyed instead of being returned to the pool, so that they are
+        not handed out again; a new session is created when one is next needed
+    */
+    DLLLOCAL void release(QoreLdapClient* l, ExceptionSink* xsink) {
+        // checked before the pool lock is acquired, because the session's lock is acquired
+        bool down = l->isConnectionDown();
+
+        client_vec_t expired;
+        {
+            AutoLocker al(m);
+            if (!valid || down) {
+                --total;
+                expired.push_back(l);
+                // a waiting thread can now create a new session
+                if (valid && waiting)
+                    cond.signal();
+            }
+            else {
+                idle.push_back({l, q_clock_getmicros()});
+                if (waiting)
+                    cond.signal();
+                getExpiredIntern(expired);
+            }
+        }
+        destroySessions(expired, xsink);
+    }
+
+    DLLLOCAL QoreHashNode* getStatus() const {
+        QoreHashNode* h = new QoreHashNode;
+        AutoLocker al(m);
+        h->setKeyValue("min", (int64)min, nullptr);
+        h->setKeyValue("max", (int64)max, nullptr);
+        h->setKeyValue("total", (int64)total, nullptr);
+        h->setKeyValue("idle", (int64)idle.size(), nullptr);
+        h->setKeyValue("in_use", (int64)(total - idle.size()), nullptr);
+        h->setKeyValue("waiting", (int64)waiting, nullptr);
+        return h;
+    }
+
+    // returns the state of each server or 0 if only one server is configured
+    DLLLOCAL QoreListNode* getServers() const {
+        return servers ? servers->getInfo() : 0;
+    }
+
+    // returns search cache statistics or 0 if there is no cache
+    DLLLOCAL QoreHashNode* getCacheStats() const {
+        return cache ? cache->getStats() : 0;
+    }
+
+    // removes all results from the search cache
+    DLLLOCAL void clearCache() {
+        if (cache)
+            cache->clear();
+    }
+
+    DLLLOCAL QoreStringNode* getUriStr() const {
+        assert(uri);
+        return uri->stringRefSelf();
+    }
+};
+
+// acquires a session from the pool and returns it when it goes out of scope
+class QoreLdapPoolSessionHelper {
+public:
+    DLLLOCAL QoreLdapPoolSessionHelper(QoreLdapClientPool* pool, const char* meth, ExceptionSink* xsink) : pool(pool), xsink(xsink), l(pool->acquire(meth, xsink)) {
+    }
+
+    DLLLOCAL ~QoreLdapPoolSessionHelper() {
+        if (l)
+            pool->release(l, xsink);
+    }
+
+    DLLLOCAL QoreLdapClient* operator->() const {
+        return l;
+    }
+
+    DLLLOCAL operator bool() const {
+        return (bool)l;
+    }
+
+protected:
+    QoreLdapClientPool* pool;
+    ExceptionSink* xsink;
+    QoreLdapClient* l;
+};
+
+#endif
@@ -0,0 +1,524 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreLdapLdif.h
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_QORELDAPLDIF_H
+
+#define _QORE_QORELDAPLDIF_H
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+
+// the maximum length of LDIF output lines before they are folded
+#define QORE_LDIF_LINE_LEN 76
+
+// LDIF (RFC 2849) record types
+enum qore_ldif_change_e : unsigned char {
+    QLC_ADD = 0,
+    QLC_DELETE,
+    QLC_MODIFY,
+    QLC_MODRDN,
+};
+
+// a record read from an LDIF file; the values are replaced when the next record is read
+struct QoreLdifRecord {
+    // the line number of the start of the record
+    int line = 0;
+    qore_ldif_change_e type = QLC_ADD;
+    ReferenceHolder<QoreStringNode> dn;
+    // attributes for add records
+    ReferenceHolder<QoreHashNode> attr;
+    // modification hashes for modify records in the format expected by LdapClient::modify()
+    ReferenceHolder<QoreListNode> mods;
+    // modrdn arguments
+    ReferenceHolder<QoreStringNode> newrdn;
+    ReferenceHolder<QoreStringNode> newsuperior;
+    bool deleteoldrdn = true;
+
+    DLLLOCAL QoreLdifRecord(ExceptionSink* xsink) : dn(xsink), attr(xsink), mods(xsink), newrdn(xsink),
+            newsuperior(xsink) {
+    }
+
+    // returns a hash describing the record
+    DLLLOCAL QoreHashNode* getHash(ExceptionSink* xsink) const {
+        static const char* types[] = {"add", "delete", "modify", "modrdn"};
+        QoreHashNode* h = new QoreHashNode(autoTypeInfo);
+        h->setKeyValue("line", (int64)line, xsink);
+        h->setKeyValue("changetype", new QoreStringNode(types[type]), xsink);
+        h->setKeyValue("dn", dn->stringRefSelf(), xsink);
+        switch (type) {
+            case QLC_ADD:
+                h->setKeyValue("attributes", attr ? attr->hashRefSelf() : new QoreHashNode(autoTypeInfo), xsink);
+                break;
+            case QLC_MODIFY:
+                h->setKeyValue("mods", mods ? mods->listRefSelf() : new QoreListNode(autoTypeInfo), xsink);
+                break;
+            case QLC_MODRDN:
+                h->setKeyValue("newrdn", newrdn->stringRefSelf(), xsink);
+                if (newsuperior)
+                    h->setKeyValue("newsuperior", newsuperior->stringRefSelf(), xsink);
+                h->setKeyValue("deleteoldrdn", deleteoldrdn, xsink);
+                break;
+            default:
+                break;
+        }
+        return h;
+    }
+
+    DLLLOCAL void clear() {
+        type = QLC_ADD;
+        dn = nullptr;
+        attr = nullptr;
+        mods = nullptr;
+        newrdn = nullptr;
+        newsuperior = nullptr;
+        deleteoldrdn = true;
+    }
+};
+
+// reads LDIF records one at a time from a file
+/** content records are returned as add records; URL values (\c "attr:< url") and controls are not supported
+*/
+class QoreLdifReader {
+public:
+    DLLLOCAL QoreLdifReader(FILE* f, const char* path) : f(f), path(path) {
+    }
+
+    DLLLOCAL ~QoreLdifReader() {
+        free(buf);
+    }
+
+    // reads the next record; returns 1 if a record was read, 0 at the end of the file, or -1 if an exception was
+    // raised
+    DLLLOCAL int next(QoreLdifRecord& rec, ExceptionSink* xsink) {
+        rec.clear();
+
+        std::string l;
+        // skip empty lines, comments, and the version line
+        while (true) {
+            if (!readLine(l))
+                return eof(xsink);
+            if (l.empty())
+                continue;
+            if (first) {
+                first = false;
+                if (!strncasecmp(l.c_str(), "version:", 8))
+                    continue;
+            }
+            break;
+        }
+
+        rec.line = line_start;
+        std::string name, value;
+        bool b64;
+        if (parseLine(l, name, value, b64, xsink))
+            return -1;
+        if (strcasecmp(name.c_str(), "dn"))
+            return error(xsink, "expecting 'dn:' at the start of the record; got '%s:' instead", name.c_str());
+        rec.dn = new QoreStringNode(value.data(), value.size(), QCS_UTF8);
+
+        if (!readLine(l) || l.empty()) {
+            // a content record with no attributes
+            rec.attr = new QoreHashNode;
+            return ok(xsink);
+        }
+        if (parseLine(l, name, value, b64, xsink))
+            return -1;
+        if (!strcasecmp(name.c_str(), "control"))
+            return error(xsink, "LDIF controls are not supported");
+
+        if (strcasecmp(name.c_str(), "changetype"))
+            return readAdd(rec, &name, &value, b64, xsink);
+
+        const char* ct = value.c_str();
+        if (!strcasecmp(ct, "add"))
+            return readAdd(rec, nullptr, nullptr, false, xsink);
+        if (!strcasecmp(ct, "delete")) {
+            rec.type = QLC_DELETE;
+            if (readLine(l) && !l.empty())
+                return error(xsink, "unexpected line '%s' in a delete record", l.c_str());
+            return ok(xsink);
+        }
+        if (!strcasecmp(ct, "modify"))
+            return readModify(rec, xsink);
+        if (!strcasecmp(ct, "modrdn") || !strcasecmp(ct, "moddn"))
+            return readModrdn(rec, xsink);
+        return error(xsink, "unsupported changetype '%s'; expecting one of 'add', 'delete', 'modify', 'modrdn', or "
+            "'moddn'", ct);
+    }
+
+protected:
+    FILE* f;
+    std::string path;
+    // the physical line read ahead of the current logical line, if any
+    std::string ahead;
+    bool have_ahead = false;
+    // set when the end of the file has been reached
+    bool done = false;
+    // set until the first record has been read
+    bool first = true;
+    // the current physical line number and the line number of the start of the current logical line
+    int line = 0;
+    int line_start = 0;
+    // the buffer for getline()
+    char* buf = nullptr;
+    size_t buf_size = 0;
+
+    // reads a physical line without the line terminator; returns false at the end of the file
+    DLLLOCAL bool readPhysical(std::string& l) {
+        if (have_ahead) {
+            have_ahead = false;
+            l.swap(ahead);
+            return true;
+        }
+        if (done)
+            return false;
+        ssize_t len = getline(&buf, &buf_size, f);
+        if (len < 0) {
+            done = true;
+            return false;
+        }
+        ++line;
+        if (len && buf[len - 1] == '\n')
+            --len;
+        if (len && buf[len - 1] == '\r')
+            --len;
+        l.assign(buf, len);
+        return true;
+    }
+
+    // reads a logical line with continuation lines joined, skipping comments; returns false at the end of the file
+    DLLLOCAL bool readLine(std::string& l) {
+        while (true) {
+            if (!readPhysical(l))
+                return false;
+            line_start = line;
+            std::string cont;
+            while (readPhysical(cont)) {
+                if (cont.empty() || cont[0] != ' ') {
+                    ahead.swap(cont);
+                    have_ahead = true;
+                    break;
+                }
+                l.append(cont, 1, std::string::npos);
+            }
+            if (l.empty() || l[0] != '#')
+                return true;
+        }
+    }
+
+    // splits a line into the attribute name and value; base64 values are decoded
+    DLLLOCAL int parseLine(const std::string& l, std::string& name, std::string& value, bool& b64, ExceptionSink* xsink) {
+        size_t colon = l.find(':');
+        if (colon == std::string::npos || !colon)
+            return error(xsink, "invalid line '%s'; expecting 'name: value'", l.c_str());
+        name.assign(l, 0, colon);
+
+        size_t p = colon + 1;
+        b64 = false;
+        if (p < l.size() && l[p] == ':') {
+            b64 = true;
+            ++p;
+        }
+        else if (p < l.size() && l[p] == '<')
+            return error(xsink, "URL values are not supported for attribute '%s'", name.c_str());
+        while (p < l.size() && l[p] == ' ')
+            ++p;
+
+        if (!b64) {
+            value.assign(l, p, std::string::npos);
+            return 0;
+        }
+        if (q_ldif_base64_decode(l.c_str() + p, l.size() - p, value))
+            return error(xsink, "invalid base64 value for attribute '%s'", name.c_str());
+        return 0;
+    }
+
+    // adds the given value to the attribute hash; base64 values are added as binary values and sent as-is
+    DLLLOCAL static void addValue(QoreHashNode& h, const std::string& name, std::string& value, bool b64,
+            ExceptionSink* xsink) {
+        QoreValue v;
+        if (b64) {
+            BinaryNode* b = new BinaryNode;
+            b->append(value.data(), value.size());
+            v = b;
+        }
+        else
+            v = new QoreStringNode(value.data(), value.size(), QCS_UTF8);
+
+        QoreValue old = h.getKeyValue(name.c_str());
+        if (old.isNothing()) {
+            h.setKeyValue(name.c_str(), v, xsink);
+            return;
+        }
+        // the list is only referenced by the hash
+        if (old.getType() == NT_LIST) {
+            old.get<QoreListNode>()->push(v, xsink);
+            return;
+        }
+        QoreListNode* l = new QoreListNode(autoTypeInfo);
+        l->push(old.refSelf(), xsink);
+        l->push(v, xsink);
+        h.setKeyValue(name.c_str(), l, xsink);
+    }
+
+    // reads the attributes of an add or content record; the first attribute may already have been read
+    DLLLOCAL int readAdd(QoreLdifRecord& rec, std::string* name, std::string* value, bool b64, ExceptionSink* xsink) {
+        rec.type = QLC_ADD;
+        rec.attr = new QoreHashNode;
+        if (name)
+            addValue(**rec.attr, *name, *value, b64, xsink);
+
+        std::string l, n, v;
+        while (readLine(l) && !l.empty()) {
+            if (parseLine(l, n, v, b64, xsink))
+                return -1;
+            addValue(**rec.attr, n, v, b64, xsink);
+        }
+        return ok(xsink);
+    }
+
+    DLLLOCAL int readModify(QoreLdifRecord& rec, ExceptionSink* xsink) {
+        rec.type = QLC_MODIFY;
+        rec.mods = new QoreListNode(autoTypeInfo);
+
+        std::string l, n, v;
+        bool b64;
+        while (readLine(l) && !l.empty()) {
+            if (parseLine(l, n, v, b64, xsink))
+                return -1;
+            const char* mod;
+            if (!strcasecmp(n.c_str(), "add"))
+                mod = "add";
+            else if (!strcasecmp(n.c_str(), "delete"))
+                mod = "delete";
+            else if (!strcasecmp(n.c_str(), "replace"))
+                mod = "replace";
+            else
+                return error(xsink, "invalid modification '%s'; expecting 'add', 'delete', or 'replace'", n.c_str());
+
+            std::string attr = v;
+            // the values of the modification are collected in a hash keyed by the attribute name
+            ReferenceHolder<QoreHashNode> vh(new QoreHashNode, xsink);
+            bool end = false;
+            while (true) {
+                // the terminating '-' is optional at the end of the record
+                if (!readLine(l) || l.empty()) {
+                    end = true;
+                    break;
+                }
+                if (l == "-")
+                    break;
+                if (parseLine(l, n, v, b64, xsink))
+                    return -1;
+                if (strcasecmp(n.c_str(), attr.c_str()))
+                    return error(xsink, "attribute '%s' does not match the attribute '%s' of the '%s' modification",
+                        n.c_str(), attr.c_str(), mod);
+                addValue(**vh, attr, v, b64, xsink);
+            }
+
+            QoreHashNode* mh = new QoreHashNode;
+            mh->setKeyValue("mod", new QoreStringNode(mod), xsink);
+            mh->setKeyValue("attr", new QoreStringNode(attr.data(), attr.size(), QCS_UTF8), xsink);
+            QoreValue val = vh->takeKeyValue(attr.c_str());
+            if (!val.isNothing())
+                mh->setKeyValue("value", val, xsink);
+            else if (!strcmp(mod, "replace"))
+                // a replace without values removes all values of the attribute
+                mh->setKeyValue("value", new QoreListNode(autoTypeInfo), xsink);
+            else if (!strcmp(mod, "add"))
+                return error(xsink, "the 'add' modification of attribute '%s' has no values", attr.c_str());
+            rec.mods->push(mh, xsink);
+
+            if (end)
+                break;
+        }
+        return ok(xsink);
+    }
+
+    DLLLOCAL int readModrdn(QoreLdifRecord& rec, ExceptionSink* xsink) {
+        rec.type = QLC_MODRDN;
+
+        std::string l, n, v;
+        bool b64;
+        while (readLine(l) && !l.empty()) {
+            if (parseLine(l, n, v, b64, xsink))
+                return -1;
+            if (!strcasecmp(n.c_str(), "newrdn"))
+                rec.newrdn = new QoreStringNode(v.data(), v.size(), QCS_UTF8);
+            else if (!strcasecmp(n.c_str(), "deleteoldrdn")) {
+                if (v != "0" && v != "1")
+                    return error(xsink, "invalid 'deleteoldrdn' value '%s'; expecting 0 or 1", v.c_str());
+                rec.deleteoldrdn = v == "1";
+            }
+            else if (!strcasecmp(n.c_str(), "newsuperior"))
+                rec.newsuperior = new QoreStringNode(v.data(), v.size(), QCS_UTF8);
+            else
+                return error(xsink, "unexpected attribute '%s' in a modrdn record", n.c_str());
+        }
+        if (!rec.newrdn)
+            return error(xsink, "the modrdn record is missing 'newrdn'");
+        return ok(xsink);
+    }
+
+    DLLLOCAL int ok(ExceptionSink* xsink) const {
+        if (ferror(f))
+            return readError(xsink);
+        return 1;
+    }
+
+    DLLLOCAL int eof(ExceptionSink* xsink) const {
+        if (ferror(f))
+            return readError(xsink);
+        return 0;
+    }
+
+    DLLLOCAL int readError(ExceptionSink* xsink) const {
+        xsink->raiseErrnoException("LDAP-LDIF-ERROR", errno, "error reading LDIF file '%s'", path.c_str());
+        return -1;
+    }
+
+    DLLLOCAL int error(ExceptionSink* xsink, const char* fmt, ...) const {
+        QoreStringNode* desc = new QoreStringNode;
+        desc->sprintf("%s:%d: ", path.c_str(), line_start);
+        va_list args;
+        while (true) {
+            va_start(args, fmt);
+            int rc = desc->vsprintf(fmt, args);
+            va_end(args);
+            if (!rc)
+                break;
+        }
+        xsink->raiseException("LDAP-LDIF-ERROR", desc);
+        return -1;
+    }
+
+    DLLLOCAL static int q_ldif_base64_decode(const char* p, size_t len, std::string& out) {
+        out.clear();
+        unsigned val = 0;
+        int bits = 0;
+        for (size_t i = 0; i < len; ++i) {
+            char c = p[i];
+            int d;
+            if (c >= 'A' && c <= 'Z')
+                d = c - 'A';
+            else if (c >= 'a' && c <= 'z')
+                d = c - 'a' + 26;
+            else if (c >= '0' && c <= '9')
+                d = c - '0' + 52;
+            else if (c == '+')
+                d = 62;
+            else if (c == '/')
+                d = 63;
+            else if (c == '=' || c == ' ')
+                continue;
+            else
+                return -1;
+            val = (val << 6) | d;
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out += (char)((val >> bits) & 0xff);
+            }
+        }
+        return 0;
+    }
+};
+
+// formats entries as LDIF records
+class QoreLdifWriter {
+public:
+    // appends an attribute line; values that are not safe strings are base64-encoded
+    DLLLOCAL static void addLine(std::string& out, const char* name, const char* val, size_t len) {
+        size_t start = out.size();
+        out += name;
+        if (isSafe(val, len)) {
+            out += ": ";
+            out.append(val, len);
+        }
+        else {
+            out += ":: ";
+            base64Encode(out, (const unsigned char*)val, len);
+        }
+        fold(out, start);
+        out += '\n';
+    }
+
+protected:
+    // returns true if the value can be written as-is (RFC 2849 SAFE-STRING); values with leading or trailing
+    // spaces are also encoded so that they are not lost
+    DLLLOCAL static bool isSafe(const char* val, size_t len) {
+        if (!len)
+            return true;
+        unsigned char c = (unsigned char)val[0];
+        if (c == ' ' || c == ':' || c == '<' || val[len - 1] == ' ')
+            return false;
+        for (size_t i = 0; i < len; ++i) {
+            c = (unsigned char)val[i];
+            if (!c || c == '\n' || c == '\r' || c > 127)
+                return false;
+        }
+        return true;
+    }
+
+    // folds the line starting at the given offset into lines of at most QORE_LDIF_LINE_LEN bytes
+    DLLLOCAL static void fold(std::string& out, size_t start) {
+        if (out.size() - start <= QORE_LDIF_LINE_LEN)
+            return;
+        std::string l(out, start);
+        out.resize(start);
+        out.append(l, 0, QORE_LDIF_LINE_LEN);
+        for (size_t p = QORE_LDIF_LINE_LEN; p < l.size(); p += QORE_LDIF_LINE_LEN - 1) {
+            out += "\n ";
+            out.append(l, p, QORE_LDIF_LINE_LEN - 1);
+        }
+    }
+
+    DLLLOCAL static void base64Encode(std::string& out, const unsigned char* p, size_t len) {
+        static const char tab[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        size_t i = 0;
+        for (; i + 2 < len; i += 3) {
+            unsigned v = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+            out += tab[v >> 18];
+            out += tab[(v >> 12) & 0x3f];
+            out += tab[(v >> 6) & 0x3f];
+            out += tab[v & 0x3f];
+        }
+        if (i < len) {
+            unsigned v = p[i] << 16;
+            if (i + 1 < len)
+                v |= p[i + 1] << 8;
+            out += tab[v >> 18];
+            out += tab[(v >> 12) & 0x3f];
+            out += i + 1 < len ? tab[(v >> 6) & 0x3f] : '=';
+            out += '=';
+        }
+    }
+};
+
+#endif
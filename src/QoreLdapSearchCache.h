@@ -0,0 +1,339 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreLdapSearchCache.h
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_QORELDAPSEARCHCACHE_H
+
+#define _QORE_QORELDAPSEARCHCACHE_H
+
+#include <ctype.h>
+#include <string.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// default maximum number of cached search results
+#define QORE_LDAP_CACHE_DEFAULT_MAX_ENTRIES 1000
+// default time to live for cached search results in milliseconds
+#define QORE_LDAP_CACHE_DEFAULT_TTL_MS 60000
+
+// search result cache configuration
+struct QoreLdapSearchCacheConfig {
+    size_t max_entries = QORE_LDAP_CACHE_DEFAULT_MAX_ENTRIES;
+    // 0 = no size limit
+    size_t max_bytes = 0;
+    // the time to live for positive outcomes; 0 = no expiration
+    int ttl_ms = QORE_LDAP_CACHE_DEFAULT_TTL_MS;
+    // the time to live for negative outcomes (empty search results, false compares, and missing entries)
+    int negative_ttl_ms = QORE_LDAP_CACHE_DEFAULT_TTL_MS;
+    // cache search results
+    bool search = true;
+    // cache compare outcomes
+    bool compare = false;
+};
+
+// a cache of search results and compare outcomes keyed by request parameters with a TTL, LRU eviction, and
+// invalidation by DN
+/** cached values only contain strings, binary values, dates, numbers, and containers thereof, so they can be
+    dereferenced without an exception sink
+*/
+class QoreLdapSearchCache {
+public:
+    DLLLOCAL QoreLdapSearchCache(const QoreLdapSearchCacheConfig& cfg) : cfg(cfg) {
+    }
+
+    DLLLOCAL ~QoreLdapSearchCache() {
+        clear();
+    }
+
+    // returns a new cache configured from the "cache" option in the given hash, or an empty pointer if the option
+    // is not present or an exception was raised
+    DLLLOCAL static std::shared_ptr<QoreLdapSearchCache> create(const QoreHashNode* opth, ExceptionSink* xsink) {
+        if (!opth)
+            return std::shared_ptr<QoreLdapSearchCache>();
+
+        QoreValue p = opth->getKeyValue("cache");
+        if (p.isNullOrNothing())
+            return std::shared_ptr<QoreLdapSearchCache>();
+        if (p.getType() != NT_HASH) {
+            // "cache": True enables the cache with the default configuration
+            if (p.getType() == NT_BOOLEAN) {
+                if (!p.getAsBool())
+                    return std::shared_ptr<QoreLdapSearchCache>();
+                return std::make_shared<QoreLdapSearchCache>(QoreLdapSearchCacheConfig());
+            }
+            xsink->raiseException("LDAP-CACHE-ERROR", "the 'cache' option has type '%s'; expecting 'hash' or 'bool'", p.getTypeName());
+            return std::shared_ptr<QoreLdapSearchCache>();
+        }
+        const QoreHashNode* ch = p.get<const QoreHashNode>();
+        QoreLdapSearchCacheConfig cfg;
+
+        int64 max_entries = QORE_LDAP_CACHE_DEFAULT_MAX_ENTRIES;
+        p = ch->getKeyValue("max_entries");
+        if (!p.isNothing()) {
+            max_entries = p.getAsBigInt();
+            if (max_entries <= 0) {
+                xsink->raiseException("LDAP-CACHE-ERROR", "invalid 'max_entries' value " QLLD "; expecting a value > 0", max_entries);
+                return std::shared_ptr<QoreLdapSearchCache>();
+            }
+        }
+
+        int64 max_bytes = ch->getKeyValue("max_bytes").getAsBigInt();
+        if (max_bytes < 0) {
+            xsink->raiseException("LDAP-CACHE-ERROR", "invalid 'max_bytes' value " QLLD "; expecting a value >= 0", max_bytes);
+            return std::shared_ptr<QoreLdapSearchCache>();
+        }
+
+        cfg.max_entries = (size_t)max_entries;
+        cfg.max_bytes = (size_t)max_bytes;
+
+        p = ch->getKeyValue("ttl");
+        if (!p.isNothing())
+            cfg.ttl_ms = getMsZeroInt(p);
+
+        // negative outcomes expire with positive outcomes unless configured separately
+        p = ch->getKeyValue("negative_ttl");
+        cfg.negative_ttl_ms = p.isNothing() ? cfg.ttl_ms : getMsZeroInt(p);
+
+        p = ch->getKeyValue("search");
+        if (!p.isNothing())
+            cfg.search = p.getAsBool();
+        cfg.compare = ch->getKeyValue("compare").getAsBool();
+
+        return std::make_shared<QoreLdapSearchCache>(cfg);
+    }
+
+    // returns a new empty cache with the same configuration
+    DLLLOCAL std::shared_ptr<QoreLdapSearchCache> copy() const {
+        return std::make_shared<QoreLdapSearchCache>(cfg);
+    }
+
+    // returns true if search results are cached
+    DLLLOCAL bool cacheSearch() const {
+        return cfg.search;
+    }
+
+    // returns true if compare outcomes are cached
+    DLLLOCAL bool cacheCompare() const {
+        return cfg.compare;
+    }
+
+    // returns a referenced value for the given key or no value if the key is not cached or has expired
+    DLLLOCAL QoreValue get(const std::string& key) {
+        AutoLocker al(m);
+        index_t::iterator i = index.find(key);
+        if (i == index.end()) {
+            ++misses;
+            return QoreValue();
+        }
+        if (i->second->expires && i->second->expires < q_clock_getmicros()) {
+            removeIntern(i->second);
+            ++misses;
+            return QoreValue();
+        }
+
+        // move to the front of the LRU list
+        lru.splice(lru.begin(), lru, i->second);
+        ++hits;
+        return i->second->value.refSelf();
+    }
+
+    // returns the current invalidation generation; must be retrieved before the request whose result is cached is
+    // sent and passed to put()
+    DLLLOCAL int64 getGeneration() const {
+        AutoLocker al(m);
+        return gen;
+    }
+
+    // caches the given value; \a base is the search base or entry DN used to invalidate the value
+    /** negative outcomes are cached with the negative TTL; the value is not cached if the cache was invalidated
+        after \a start_gen was retrieved with getGeneration(), because the value could be stale
+    */
+    DLLLOCAL void put(const std::string& key, int64 start_gen, const char* base, QoreValue v, bool negative = false) {
+        size_t size = key.size() + getSize(v);
+        // do not cache values that could never fit
+        if (cfg.max_bytes && size > cfg.max_bytes)
+            return;
+
+        AutoLocker al(m);
+        if (start_gen != gen)
+            return;
+        index_t::iterator i = index.find(key);
+        if (i != index.end())
+            removeIntern(i->second);
+
+        lru.push_front(Entry());
+        Entry& e = lru.front();
+        e.key = key;
+        e.base = normalizeDn(base);
+        e.value = v.refSelf();
+        e.bytes = size;
+        int ttl_ms = negative ? cfg.negative_ttl_ms : cfg.ttl_ms;
+        e.expires = ttl_ms ? q_clock_getmicros() + (int64)ttl_ms * 1000 : 0;
+        index[key] = lru.begin();
+        bytes += size;
+        if (negative)
+            ++negative_puts;
+
+        // evict the least recently used entries
+        while (lru.size() > cfg.max_entries || (cfg.max_bytes && bytes > cfg.max_bytes)) {
+            removeIntern(--lru.end());
+            ++evictions;
+        }
+    }
+
+    // removes all values whose search base is equal to, above, or below the given DN
+    DLLLOCAL void invalidate(const char* dn) {
+        std::string ndn = normalizeDn(dn);
+        AutoLocker al(m);
+        ++gen;
+        for (entry_list_t::iterator i = lru.begin(), e = lru.end(); i != e;) {
+            entry_list_t::iterator ci = i++;
+            if (affects(ndn, ci->base)) {
+                removeIntern(ci);
+                ++invalidations;
+            }
+        }
+    }
+
+    // removes all cached values
+    DLLLOCAL void clear() {
+        AutoLocker al(m);
+        ++gen;
+        for (auto& i : lru)
+            i.value.discard(nullptr);
+        lru.clear();
+        index.clear();
+        bytes = 0;
+    }
+
+    DLLLOCAL QoreHashNode* getStats() const {
+        QoreHashNode* h = new QoreHashNode;
+        AutoLocker al(m);
+        h->setKeyValue("hits", hits, nullptr);
+        h->setKeyValue("misses", misses, nullptr);
+        h->setKeyValue("evictions", evictions, nullptr);
+        h->setKeyValue("invalidations", invalidations, nullptr);
+        h->setKeyValue("negative", negative_puts, nullptr);
+        h->setKeyValue("entries", (int64)lru.size(), nullptr);
+        h->setKeyValue("bytes", (int64)bytes, nullptr);
+        h->setKeyValue("max_entries", (int64)cfg.max_entries, nullptr);
+        h->setKeyValue("max_bytes", (int64)cfg.max_bytes, nullptr);
+        h->setKeyValue("ttl", (int64)cfg.ttl_ms, nullptr);
+        h->setKeyValue("negative_ttl", (int64)cfg.negative_ttl_ms, nullptr);
+        h->setKeyValue("search", cfg.search, nullptr);
+        h->setKeyValue("compare", cfg.compare, nullptr);
+        return h;
+    }
+
+    // returns a normalized DN for comparisons: lower case without spaces around separators
+    DLLLOCAL static std::string normalizeDn(const char* dn) {
+        std::string rv;
+        rv.reserve(strlen(dn));
+        for (const char* p = dn; *p; ++p) {
+            if (*p == ' ' && (rv.empty() || rv.back() == ',' || rv.back() == '=' || rv.back() == '+' || p[1] == ',' || p[1] == '=' || p[1] == '+' || !p[1]))
+                continue;
+            rv += tolower((unsigned char)*p);
+        }
+        return rv;
+    }
+
+protected:
+    struct Entry {
+        std::string key;
+        // the normalized search base or entry DN
+        std::string base;
+        QoreValue value;
+        // the approximate size of the entry in bytes
+        size_t bytes;
+        // the expiration time in microseconds; 0 = never
+        int64 expires;
+    };
+
+    // the most recently used entries are at the front
+    typedef std::list<Entry> entry_list_t;
+    typedef std::unordered_map<std::string, entry_list_t::iterator> index_t;
+
+    mutable QoreThreadLock m;
+    entry_list_t lru;
+    index_t index;
+    QoreLdapSearchCacheConfig cfg;
+    size_t bytes = 0;
+    // incremented each time values are invalidated or cleared
+    int64 gen = 0;
+    int64 hits = 0,
+        misses = 0,
+        evictions = 0,
+        invalidations = 0,
+        negative_puts = 0;
+
+    // the lock must be held
+    DLLLOCAL void removeIntern(entry_list_t::iterator i) {
+        bytes -= i->bytes;
+        i->value.discard(nullptr);
+        index.erase(i->key);
+        lru.erase(i);
+    }
+
+    // returns true if a change to the entry with the given DN could affect a search with the given base
+    DLLLOCAL static bool affects(const std::string& dn, const std::string& base) {
+        return base.empty() || isAtOrBelow(dn, base) || isAtOrBelow(base, dn);
+    }
+
+    // returns true if \a dn is equal to or a descendant of \a base
+    DLLLOCAL static bool isAtOrBelow(const std::string& dn, const std::string& base) {
+        if (dn.size() == base.size())
+            return dn == base;
+        return dn.size() > base.size() && dn[dn.size() - base.size() - 1] == ','
+            && !dn.compare(dn.size() - base.size(), base.size(), base);
+    }
+
+    // returns the approximate memory size of the given value
+    DLLLOCAL static size_t getSize(QoreValue v) {
+        switch (v.getType()) {
+            case NT_STRING:
+                return sizeof(QoreStringNode) + v.get<const QoreStringNode>()->size();
+            case NT_BINARY:
+                return sizeof(BinaryNode) + v.get<const BinaryNode>()->size();
+            case NT_LIST: {
+                size_t rv = sizeof(QoreListNode);
+                ConstListIterator li(v.get<const QoreListNode>());
+                while (li.next())
+                    rv += sizeof(QoreValue) + getSize(li.getValue());
+                return rv;
+            }
+            case NT_HASH: {
+                size_t rv = sizeof(QoreHashNode);
+                ConstHashIterator hi(v.get<const QoreHashNode>());
+                while (hi.next())
+                    rv += 64 + strlen(hi.getKey()) + getSize(hi.get());
+                return rv;
+            }
+            default:
+                return sizeof(QoreValue);
+        }
+    }
+};
+
+#endif
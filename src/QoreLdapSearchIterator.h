@@ -0,0 +1,122 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreLdapSearchIterator.h
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_QORELDAPSEARCHITERATOR_H
+
+#define _QORE_QORELDAPSEARCHITERATOR_H
+
+#include "QoreLdapClient.h"
+
+DLLLOCAL extern qore_classid_t CID_LDAPSEARCHITERATOR;
+DLLLOCAL extern QoreClass* QC_LDAPSEARCHITERATOR;
+
+// the c++ object
+class QoreLdapSearchIterator : public AbstractPrivateData {
+protected:
+    // mutual-exclusion lock
+    mutable QoreThreadLock m;
+    // the client executing the search
+    QoreLdapClient* ldap;
+    // the current entry
+    QoreHashNode* value;
+    // the search state; 0 if the search is complete
+    QoreLdapSearchStream* ss;
+    // the timeout for retrieving each entry in ms
+    int timeout_ms;
+
+    // ends the search; the lock must be held
+    DLLLOCAL void endIntern(ExceptionSink* xsink) {
+        if (ss) {
+            ldap->searchEnd(*ss, xsink);
+            ss->del(xsink);
+            ss = 0;
+        }
+    }
+
+public:
+    DLLLOCAL QoreLdapSearchIterator(QoreLdapClient* l, const QoreHashNode& h, int my_timeout_ms, ExceptionSink* xsink) : ldap(l), value(0), ss(new QoreLdapSearchStream(h, xsink)), timeout_ms(my_timeout_ms) {
+        ldap->ref();
+
+        if (ss->parse() || ldap->searchStream(xsink, *ss)) {
+            ss->del(xsink);
+            ss = 0;
+        }
+    }
+
+    DLLLOCAL ~QoreLdapSearchIterator() {
+        assert(!ldap);
+        assert(!value);
+        assert(!ss);
+    }
+
+    DLLLOCAL int destructor(ExceptionSink* xsink) {
+        AutoLocker al(m);
+        if (ldap) {
+            endIntern(xsink);
+            ldap->deref(xsink);
+            ldap = 0;
+        }
+        if (value) {
+            value->deref(xsink);
+            value = 0;
+        }
+        return 0;
+    }
+
+    //! retrieves the next entry; returns false if there are no more entries or an exception was raised
+    DLLLOCAL bool next(ExceptionSink* xsink) {
+        AutoLocker al(m);
+        if (value) {
+            value->deref(xsink);
+            value = 0;
+        }
+        if (!ss)
+            return false;
+
+        ReferenceHolder<QoreHashNode> entry(xsink);
+        int rc = ldap->searchNext(xsink, *ss, timeout_ms, entry);
+        if (rc <= 0) {
+            endIntern(xsink);
+            return false;
+        }
+
+        value = entry.release();
+        return true;
+    }
+
+    DLLLOCAL QoreHashNode* getValue(ExceptionSink* xsink) const {
+        AutoLocker al(m);
+        if (!value) {
+            xsink->raiseException("ITERATOR-ERROR", "the LdapSearchIterator is not pointing at a valid element; make sure LdapSearchIterator::next() returns True before calling this method");
+            return 0;
+        }
+        return value->hashRefSelf();
+    }
+
+    DLLLOCAL bool valid() const {
+        AutoLocker al(m);
+        return (bool)value;
+    }
+};
+
+#endif
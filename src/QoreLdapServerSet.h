@@ -0,0 +1,248 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreLdapServerSet.h
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_QORELDAPSERVERSET_H
+
+#define _QORE_QORELDAPSERVERSET_H
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// default number of consecutive failures after which a server is skipped
+#define QORE_LDAP_DEFAULT_FAILURE_THRESHOLD 3
+// default time a server is skipped after reaching the failure threshold in milliseconds
+#define QORE_LDAP_DEFAULT_CIRCUIT_TIMEOUT_MS 30000
+
+// server selection policies
+enum qore_ldap_selection_e : unsigned char {
+    // start with the next server in the list for each new connection
+    QLSS_ROUND_ROBIN = 0,
+    // prefer the server with the lowest recent response time
+    QLSS_LEAST_LATENCY,
+};
+
+// a list of servers with health tracking for selecting the server for new connections; shared by all sessions in
+// a pool
+/** a server that fails the given number of times in a row is skipped for the circuit timeout; afterwards it's tried
+    again, and a single further failure skips it again
+*/
+class QoreLdapServerSet {
+public:
+    DLLLOCAL QoreLdapServerSet(qore_ldap_selection_e policy, int failure_threshold, int circuit_timeout_ms) : policy(policy), failure_threshold(failure_threshold), circuit_timeout_ms(circuit_timeout_ms) {
+    }
+
+    // returns a server set for the given URI and options, or an empty pointer if only one server is configured or
+    // if an exception was raised
+    /** the URI can contain multiple URIs separated by whitespace, and additional servers can be given with the
+        \c servers option
+    */
+    DLLLOCAL static std::shared_ptr<QoreLdapServerSet> create(const QoreStringNode& uristr, const QoreHashNode* opth, ExceptionSink* xsink) {
+        std::vector<std::string> uris;
+        addUris(uris, uristr.c_str());
+
+        qore_ldap_selection_e policy = QLSS_ROUND_ROBIN;
+        int failure_threshold = QORE_LDAP_DEFAULT_FAILURE_THRESHOLD;
+        int circuit_timeout_ms = QORE_LDAP_DEFAULT_CIRCUIT_TIMEOUT_MS;
+        if (opth) {
+            QoreValue v = opth->getKeyValue("servers");
+            if (v.getType() == NT_STRING)
+                addUris(uris, v.get<const QoreStringNode>()->c_str());
+            else if (v.getType() == NT_LIST) {
+                ConstListIterator li(v.get<const QoreListNode>());
+                while (li.next()) {
+                    QoreValue s = li.getValue();
+                    if (s.getType() != NT_STRING) {
+                        xsink->raiseException("LDAP-SERVER-ERROR", "the 'servers' option must be a list of strings; got an element of type '%s' instead", s.getFullTypeName());
+                        return std::shared_ptr<QoreLdapServerSet>();
+                    }
+                    addUris(uris, s.get<const QoreStringNode>()->c_str());
+                }
+            } else if (!v.isNothing()) {
+                xsink->raiseException("LDAP-SERVER-ERROR", "the 'servers' option must be a list of strings; got type '%s' instead", v.getFullTypeName());
+                return std::shared_ptr<QoreLdapServerSet>();
+            }
+
+            v = opth->getKeyValue("server_selection");
+            if (!v.isNothing()) {
+                QoreStringValueHelper str(v);
+                if (!strcmp(str->c_str(), "round-robin"))
+                    policy = QLSS_ROUND_ROBIN;
+                else if (!strcmp(str->c_str(), "least-latency"))
+                    policy = QLSS_LEAST_LATENCY;
+                else {
+                    xsink->raiseException("LDAP-SERVER-ERROR", "invalid 'server_selection' value '%s'; expecting \"round-robin\" or \"least-latency\"", str->c_str());
+                    return std::shared_ptr<QoreLdapServerSet>();
+                }
+            }
+
+            v = opth->getKeyValue("failure_threshold");
+            if (!v.isNothing()) {
+                failure_threshold = (int)v.getAsBigInt();
+                if (failure_threshold <= 0) {
+                    xsink->raiseException("LDAP-SERVER-ERROR", "invalid 'failure_threshold' value %d; expecting a value > 0", failure_threshold);
+                    return std::shared_ptr<QoreLdapServerSet>();
+                }
+            }
+
+            v = opth->getKeyValue("circuit_timeout");
+            if (!v.isNothing())
+                circuit_timeout_ms = getMsZeroInt(v);
+        }
+
+        if (uris.size() < 2)
+            return std::shared_ptr<QoreLdapServerSet>();
+
+        std::shared_ptr<QoreLdapServerSet> rv = std::make_shared<QoreLdapServerSet>(policy, failure_threshold, circuit_timeout_ms);
+        for (auto& i : uris)
+            rv->servers.emplace_back(new Server(i));
+        return rv;
+    }
+
+    // returns the indexes of the servers to try for a new connection in order of preference
+    /** servers that are being skipped after failures are only tried after all other servers
+    */
+    DLLLOCAL std::vector<unsigned> getOrder() {
+        int64 now = q_clock_getmicros();
+        unsigned n = servers.size();
+        unsigned start = policy == QLSS_ROUND_ROBIN ? next.fetch_add(1, std::memory_order_relaxed) % n : 0;
+
+        std::vector<unsigned> rv, skipped;
+        for (unsigned i = 0; i < n; ++i) {
+            unsigned idx = (start + i) % n;
+            if (servers[idx]->open_until.load(std::memory_order_relaxed) > now)
+                skipped.push_back(idx);
+            else
+                rv.push_back(idx);
+        }
+        // servers without a response time yet are tried first
+        if (policy == QLSS_LEAST_LATENCY) {
+            std::stable_sort(rv.begin(), rv.end(), [&] (unsigned a, unsigned b) {
+                return servers[a]->latency_us.load(std::memory_order_relaxed) < servers[b]->latency_us.load(std::memory_order_relaxed);
+            });
+        }
+        rv.insert(rv.end(), skipped.begin(), skipped.end());
+        return rv;
+    }
+
+    DLLLOCAL const std::string& getUri(unsigned idx) const {
+        return servers[idx]->uri;
+    }
+
+    // records a successful request with the given server response time
+    DLLLOCAL void success(unsigned idx, int64 us) {
+        Server& s = *servers[idx];
+        s.requests.fetch_add(1, std::memory_order_relaxed);
+        // exponentially weighted moving average; concurrent updates may be lost, which only affects accuracy
+        int64 l = s.latency_us.load(std::memory_order_relaxed);
+        if (us < 1)
+            us = 1;
+        s.latency_us.store(l ? l + (us - l) / 5 : us, std::memory_order_relaxed);
+        if (s.failures.load(std::memory_order_relaxed)) {
+            s.failures.store(0, std::memory_order_relaxed);
+            s.open_until.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // records a successful connection to the given server
+    DLLLOCAL void connected(unsigned idx) {
+        Server& s = *servers[idx];
+        if (s.failures.load(std::memory_order_relaxed)) {
+            s.failures.store(0, std::memory_order_relaxed);
+            s.open_until.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // records a failure to connect to or get a response from the given server
+    DLLLOCAL void failure(unsigned idx) {
+        Server& s = *servers[idx];
+        s.requests.fetch_add(1, std::memory_order_relaxed);
+        s.errors.fetch_add(1, std::memory_order_relaxed);
+        if (s.failures.fetch_add(1, std::memory_order_relaxed) + 1 >= failure_threshold)
+            s.open_until.store(q_clock_getmicros() + (int64)circuit_timeout_ms * 1000, std::memory_order_relaxed);
+    }
+
+    // returns a list of hashes with the state of each server
+    DLLLOCAL QoreListNode* getInfo(int current = -1) const {
+        int64 now = q_clock_getmicros();
+        QoreListNode* l = new QoreListNode(autoTypeInfo);
+        for (unsigned i = 0; i < servers.size(); ++i) {
+            const Server& s = *servers[i];
+            QoreHashNode* h = new QoreHashNode;
+            h->setKeyValue("uri", new QoreStringNode(s.uri), nullptr);
+            h->setKeyValue("latency_us", s.latency_us.load(std::memory_order_relaxed), nullptr);
+            h->setKeyValue("failures", (int64)s.failures.load(std::memory_order_relaxed), nullptr);
+            h->setKeyValue("requests", s.requests.load(std::memory_order_relaxed), nullptr);
+            h->setKeyValue("errors", s.errors.load(std::memory_order_relaxed), nullptr);
+            h->setKeyValue("available", s.open_until.load(std::memory_order_relaxed) <= now, nullptr);
+            if (current >= 0)
+                h->setKeyValue("current", (int)i == current, nullptr);
+            l->push(h, nullptr);
+        }
+        return l;
+    }
+
+protected:
+    struct Server {
+        std::string uri;
+        // the moving average of server response times in microseconds; 0 = no response yet
+        std::atomic<int64> latency_us{0};
+        // the number of consecutive failures
+        std::atomic<int> failures{0};
+        // the time until which the server is skipped in microseconds; 0 = not skipped
+        std::atomic<int64> open_until{0};
+        // the total number of requests and failures
+        std::atomic<int64> requests{0};
+        std::atomic<int64> errors{0};
+
+        DLLLOCAL Server(const std::string& uri) : uri(uri) {
+        }
+    };
+
+    std::vector<std::unique_ptr<Server>> servers;
+    // the index of the next server for round-robin selection
+    std::atomic<unsigned> next{0};
+    qore_ldap_selection_e policy;
+    int failure_threshold;
+    int circuit_timeout_ms;
+
+    // adds the whitespace-separated URIs in the given string to the list
+    DLLLOCAL static void addUris(std::vector<std::string>& uris, const char* p) {
+        while (*p) {
+            while (*p && isspace((unsigned char)*p))
+                ++p;
+            const char* start = p;
+            while (*p && !isspace((unsigned char)*p))
+                ++p;
+            if (p > start)
+                uris.push_back(std::string(start, p - start));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,299 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreLdapStats.h
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_QORELDAPSTATS_H
+
+#define _QORE_QORELDAPSTATS_H
+
+#include <atomic>
+
+// the number of buckets in each latency histogram; bucket n counts times less than 2^n microseconds, and the last
+// bucket counts all longer times
+#define QORE_LDAP_STATS_BUCKETS 24
+
+// operation types for statistics; the values up to QLS_PASSWD match qore_ldap_op_e
+enum qore_ldap_stat_op_e : signed char {
+    QLS_NONE = -1,
+    QLS_SEARCH = 0,
+    QLS_ADD,
+    QLS_MODIFY,
+    QLS_DELETE,
+    QLS_COMPARE,
+    QLS_RENAME,
+    QLS_PASSWD,
+    QLS_BIND,
+    QLS_NUM
+};
+
+// the phases of an operation that are timed separately
+enum qore_ldap_phase_e : unsigned char {
+    // waiting for the session lock
+    QLP_LOCK = 0,
+    // converting arguments, encoding, and sending the request
+    QLP_SEND,
+    // waiting for the server's responses
+    QLP_WAIT,
+    // decoding the responses and building the result
+    QLP_DECODE,
+    QLP_NUM
+};
+
+// a latency histogram with power of two buckets in microseconds; updated without locking
+class QoreLdapHistogram {
+public:
+    DLLLOCAL QoreLdapHistogram() {
+        reset();
+    }
+
+    DLLLOCAL void add(int64 us) {
+        total_us.fetch_add(us, std::memory_order_relaxed);
+        int64 m = max_us.load(std::memory_order_relaxed);
+        while (us > m && !max_us.compare_exchange_weak(m, us, std::memory_order_relaxed)) {
+        }
+        unsigned b = 0;
+        while (us > 0 && b < QORE_LDAP_STATS_BUCKETS - 1) {
+            us >>= 1;
+            ++b;
+        }
+        buckets[b].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    DLLLOCAL void reset() {
+        total_us.store(0, std::memory_order_relaxed);
+        max_us.store(0, std::memory_order_relaxed);
+        for (auto& i : buckets)
+            i.store(0, std::memory_order_relaxed);
+    }
+
+    // returns a hash with total_us, max_us, and histogram keys
+    DLLLOCAL QoreHashNode* get() const {
+        QoreHashNode* h = new QoreHashNode;
+        h->setKeyValue("total_us", total_us.load(std::memory_order_relaxed), nullptr);
+        h->setKeyValue("max_us", max_us.load(std::memory_order_relaxed), nullptr);
+        // only non-empty buckets are returned
+        QoreListNode* l = new QoreListNode(autoTypeInfo);
+        for (unsigned b = 0; b < QORE_LDAP_STATS_BUCKETS; ++b) {
+            int64 n = buckets[b].load(std::memory_order_relaxed);
+            if (!n)
+                continue;
+            QoreHashNode* bh = new QoreHashNode;
+            if (b < QORE_LDAP_STATS_BUCKETS - 1)
+                bh->setKeyValue("lt_us", (int64)1 << b, nullptr);
+            bh->setKeyValue("count", n, nullptr);
+            l->push(bh, nullptr);
+        }
+        h->setKeyValue("histogram", l, nullptr);
+        return h;
+    }
+
+protected:
+    std::atomic<int64> total_us;
+    std::atomic<int64> max_us;
+    std::atomic<int64> buckets[QORE_LDAP_STATS_BUCKETS];
+};
+
+// counters and latency histograms for one operation type
+struct QoreLdapOpStats {
+    std::atomic<int64> count;
+    std::atomic<int64> errors;
+    std::atomic<int64> entries;
+    std::atomic<int64> bytes;
+    QoreLdapHistogram phases[QLP_NUM];
+    QoreLdapHistogram total;
+
+    DLLLOCAL QoreLdapOpStats() {
+        reset();
+    }
+
+    DLLLOCAL void reset() {
+        count.store(0, std::memory_order_relaxed);
+        errors.store(0, std::memory_order_relaxed);
+        entries.store(0, std::memory_order_relaxed);
+        bytes.store(0, std::memory_order_relaxed);
+        for (auto& i : phases)
+            i.reset();
+        total.reset();
+    }
+};
+
+// always-on operation statistics for a session; updated without locking
+class QoreLdapStats {
+public:
+    DLLLOCAL void record(qore_ldap_stat_op_e op, const int64* us, bool error, int64 entries, int64 bytes) {
+        assert(op >= 0 && op < QLS_NUM);
+        QoreLdapOpStats& s = ops[op];
+        s.count.fetch_add(1, std::memory_order_relaxed);
+        if (error)
+            s.errors.fetch_add(1, std::memory_order_relaxed);
+        if (entries)
+            s.entries.fetch_add(entries, std::memory_order_relaxed);
+        if (bytes)
+            s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        int64 total = 0;
+        for (unsigned i = 0; i < QLP_NUM; ++i) {
+            s.phases[i].add(us[i]);
+            total += us[i];
+        }
+        s.total.add(total);
+    }
+
+    DLLLOCAL void reset() {
+        for (auto& i : ops)
+            i.reset();
+    }
+
+    // returns a hash keyed by operation type
+    DLLLOCAL QoreHashNode* get() const {
+        QoreHashNode* h = new QoreHashNode;
+        for (unsigned i = 0; i < QLS_NUM; ++i) {
+            const QoreLdapOpStats& s = ops[i];
+            QoreHashNode* oh = new QoreHashNode;
+            oh->setKeyValue("count", s.count.load(std::memory_order_relaxed), nullptr);
+            oh->setKeyValue("errors", s.errors.load(std::memory_order_relaxed), nullptr);
+            oh->setKeyValue("entries", s.entries.load(std::memory_order_relaxed), nullptr);
+            oh->setKeyValue("bytes", s.bytes.load(std::memory_order_relaxed), nullptr);
+            for (unsigned p = 0; p < QLP_NUM; ++p)
+                oh->setKeyValue(getPhaseName((qore_ldap_phase_e)p), s.phases[p].get(), nullptr);
+            oh->setKeyValue("total", s.total.get(), nullptr);
+            h->setKeyValue(getOpName((qore_ldap_stat_op_e)i), oh, nullptr);
+        }
+        return h;
+    }
+
+    DLLLOCAL static const char* getOpName(qore_ldap_stat_op_e op) {
+        switch (op) {
+            case QLS_SEARCH: return "search";
+            case QLS_ADD: return "add";
+            case QLS_MODIFY: return "modify";
+            case QLS_DELETE: return "del";
+            case QLS_COMPARE: return "compare";
+            case QLS_RENAME: return "rename";
+            case QLS_PASSWD: return "passwd";
+            case QLS_BIND: return "bind";
+            default: return "unknown";
+        }
+    }
+
+    DLLLOCAL static const char* getPhaseName(qore_ldap_phase_e p) {
+        switch (p) {
+            case QLP_LOCK: return "lock";
+            case QLP_SEND: return "send";
+            case QLP_WAIT: return "wait";
+            case QLP_DECODE: return "decode";
+            default: return "unknown";
+        }
+    }
+
+protected:
+    QoreLdapOpStats ops[QLS_NUM];
+};
+
+// times the phases of a single operation and records them in the statistics when it's done
+/** the operation is only recorded if an operation type has been set; an operation is counted as an error if an
+    exception has been raised when it's recorded or if it has been marked as failed
+*/
+class QoreLdapOpTimer {
+public:
+    // the message ID of the request or -1 if none was sent
+    int msgid = -1;
+    // the LDAP result code of the operation
+    int result = 0;
+    // the DN or the search base and filter of the request for tracing; must remain valid until the timer is done
+    const QoreStringNode* dn = nullptr;
+    const QoreStringNode* base = nullptr;
+    const QoreStringNode* filter = nullptr;
+    // set if the operation failed without an exception being raised, such as an operation in a batch whose result
+    // code is returned to the caller
+    bool failed = false;
+
+    // creates the timer; if \a start is not 0, then the current phase started at the given time in microseconds
+    DLLLOCAL QoreLdapOpTimer(QoreLdapStats& stats, ExceptionSink* xsink, qore_ldap_stat_op_e op = QLS_NONE, qore_ldap_phase_e cur = QLP_SEND, int64 start = 0) : stats(stats), xsink(xsink), op(op), cur(cur), last(start ? start : q_clock_getmicros()) {
+    }
+
+    DLLLOCAL ~QoreLdapOpTimer() {
+        done();
+    }
+
+    // ends the operation and records it in the statistics; returns false if the operation was not recorded
+    DLLLOCAL bool done() {
+        if (op == QLS_NONE || recorded)
+            return false;
+        phase(cur);
+        recorded = true;
+        stats.record(op, us, isError(), entries, bytes);
+        return true;
+    }
+
+    // returns true if the operation failed
+    DLLLOCAL bool isError() const {
+        return failed || *xsink;
+    }
+
+    // ends the current phase and starts the given phase
+    DLLLOCAL void phase(qore_ldap_phase_e p) {
+        int64 now = q_clock_getmicros();
+        us[cur] += now - last;
+        last = now;
+        cur = p;
+    }
+
+    DLLLOCAL void setOp(qore_ldap_stat_op_e o) {
+        op = o;
+    }
+
+    DLLLOCAL qore_ldap_stat_op_e getOp() const {
+        return op;
+    }
+
+    // returns the time spent in the given phase in microseconds
+    DLLLOCAL int64 getTime(qore_ldap_phase_e p) const {
+        return us[p];
+    }
+
+    // returns the total time of the operation in microseconds
+    DLLLOCAL int64 getTotal() const {
+        int64 total = 0;
+        for (unsigned i = 0; i < QLP_NUM; ++i)
+            total += us[i];
+        return total;
+    }
+
+    DLLLOCAL void addResults(int64 e, int64 b) {
+        entries += e;
+        bytes += b;
+    }
+
+protected:
+    QoreLdapStats& stats;
+    ExceptionSink* xsink;
+    qore_ldap_stat_op_e op;
+    qore_ldap_phase_e cur;
+    int64 last;
+    int64 us[QLP_NUM] = {0, 0, 0, 0};
+    int64 entries = 0;
+    int64 bytes = 0;
+    // set when the operation has been recorded
+    bool recorded = false;
+};
+
+#endif
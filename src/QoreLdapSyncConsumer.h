@@ -0,0 +1,652 @@
+/* -*- mode: c++; indent-tabs-mode: nil -*- */
+/*
+    QoreLdapSyncConsumer.h
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _QORE_QORELDAPSYNCCONSUMER_H
+
+#define _QORE_QORELDAPSYNCCONSUMER_H
+
+#include "QoreLdapClient.h"
+
+#include <set>
+#include <unordered_map>
+
+// the e-syncRefreshRequired result code from RFC 4533
+#ifndef LDAP_SYNC_REFRESH_REQUIRED
+#define LDAP_SYNC_REFRESH_REQUIRED 0x1000
+#endif
+
+// the interval for checking if a synchronization has been stopped while waiting for responses in ms
+#define QORE_LDAP_SYNC_POLL_MS 250
+
+DLLLOCAL extern qore_classid_t CID_LDAPSYNCCONSUMER;
+DLLLOCAL extern QoreClass* QC_LDAPSYNCCONSUMER;
+
+// the c++ object
+/** maintains an in-memory replica of the entries matching a search with the content synchronization operation
+    (RFC 4533); entries are identified by their entryUUID and indexed by DN and by the configured attributes
+*/
+class QoreLdapSyncConsumer : public AbstractPrivateData {
+protected:
+    // a replicated entry
+    struct Entry {
+        std::string dn;
+        QoreHashNode* attrs;
+    };
+
+    // map of entryUUIDs to entries
+    typedef std::map<std::string, Entry> entry_map_t;
+    // map of normalized DNs to entryUUIDs
+    typedef std::unordered_map<std::string, std::string> dn_map_t;
+    // map of attribute values to entryUUIDs
+    typedef std::map<std::string, std::set<std::string>> value_map_t;
+    // map of lower-case attribute names to value indexes
+    typedef std::map<std::string, value_map_t> index_map_t;
+
+    // mutual-exclusion lock for the replica and the synchronization state
+    mutable QoreThreadLock m;
+    // signaled when a synchronization ends
+    QoreCondition cond;
+    // the client executing the synchronization search
+    QoreLdapClient* client;
+    // the search parameters
+    QoreLdapSearchStream* ss;
+    // the change callback, if any
+    ResolvedCallReferenceNode* cb;
+    // the replica
+    entry_map_t entries;
+    dn_map_t dns;
+    index_map_t index;
+    // the current synchronization cookie
+    std::string cookie;
+    // entryUUIDs reported as present in the current refresh phase
+    std::set<std::string> present;
+    // set while the current synchronization is in the refresh phase
+    bool in_refresh = false;
+    // the TID of the thread running the synchronization; 0 = none
+    int tid = 0;
+    // set if the synchronization should be stopped
+    bool stop_sync = false;
+    // set when the initial refresh phase has completed
+    bool refreshed = false;
+    // set when the object has been destroyed
+    bool destroyed = false;
+    // the number of changes applied by the current synchronization
+    int64 changes = 0;
+
+    // an entry change to report to the callback
+    struct Event {
+        const char* type;
+        std::string uuid;
+        std::string dn;
+        QoreHashNode* attrs;
+    };
+    typedef std::vector<Event> event_list_t;
+
+    // returns the string form of the given entryUUID value
+    DLLLOCAL static QoreStringNode* formatUuid(const std::string& uuid) {
+        if (uuid.size() != 16) {
+            QoreStringNode* str = new QoreStringNode;
+            for (unsigned char c : uuid)
+                str->sprintf("%02x", c);
+            return str;
+        }
+        const unsigned char* p = (const unsigned char*)uuid.data();
+        QoreStringNode* str = new QoreStringNode;
+        str->sprintf("%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x", p[0], p[1], p[2], p[3],
+            p[4], p[5], p[6], p[7], p[8], p[9], p[10], p[11], p[12], p[13], p[14], p[15]);
+        return str;
+    }
+
+    // returns a hash with "dn" and "attributes" keys for the given entry; the lock must be held
+    DLLLOCAL static QoreHashNode* makeEntry(const Entry& e) {
+        QoreHashNode* h = new QoreHashNode;
+        h->setKeyValue("dn", new QoreStringNode(e.dn.c_str(), QCS_UTF8), nullptr);
+        h->setKeyValue("attributes", e.attrs->hashRefSelf(), nullptr);
+        return h;
+    }
+
+    // calls the given function for each string form of the values of the given attribute hash
+    template <typename F>
+    DLLLOCAL static void forEachIndexValue(const QoreHashNode* attrs, const std::string& attr, F f) {
+        ConstHashIterator hi(attrs);
+        while (hi.next()) {
+            if (QoreLdapResultOpts::getKey(hi.getKey()) != attr)
+                continue;
+            QoreValue v = hi.get();
+            if (v.getType() == NT_LIST) {
+                ConstListIterator li(v.get<const QoreListNode>());
+                while (li.next())
+                    addIndexValue(li.getValue(), f);
+            } else {
+                addIndexValue(v, f);
+            }
+        }
+    }
+
+    template <typename F>
+    DLLLOCAL static void addIndexValue(QoreValue v, F f) {
+        // binary values are not indexed
+        if (v.getType() == NT_BINARY || v.isNothing())
+            return;
+        QoreStringValueHelper str(v, QCS_UTF8, nullptr);
+        f(std::string(str->c_str(), str->size()));
+    }
+
+    // adds or removes the given entry from the attribute indexes; the lock must be held
+    DLLLOCAL void indexIntern(const std::string& uuid, const QoreHashNode* attrs, bool add) {
+        for (auto& i : index) {
+            value_map_t& vm = i.second;
+            forEachIndexValue(attrs, i.first, [&] (const std::string& val) {
+                if (add) {
+                    vm[val].insert(uuid);
+                    return;
+                }
+                value_map_t::iterator vi = vm.find(val);
+                if (vi == vm.end())
+                    return;
+                vi->second.erase(uuid);
+                if (vi->second.empty())
+                    vm.erase(vi);
+            });
+        }
+    }
+
+    // removes the given entry from the replica; the lock must be held
+    DLLLOCAL void removeIntern(entry_map_t::iterator i, event_list_t& events) {
+        indexIntern(i->first, i->second.attrs, false);
+        dns.erase(QoreLdapSearchCache::normalizeDn(i->second.dn.c_str()));
+        events.push_back({"delete", i->first, i->second.dn, i->second.attrs});
+        entries.erase(i);
+        ++changes;
+    }
+
+    // adds or replaces the given entry in the replica; the lock must be held
+    DLLLOCAL void updateIntern(const std::string& uuid, const char* dn, QoreHashNode* attrs, event_list_t& events) {
+        entry_map_t::iterator i = entries.find(uuid);
+        const char* type;
+        if (i == entries.end()) {
+            i = entries.insert(entry_map_t::value_type(uuid, {dn, attrs})).first;
+            type = "add";
+        } else {
+            // the DN changes when the entry is renamed or moved
+            indexIntern(uuid, i->second.attrs, false);
+            dns.erase(QoreLdapSearchCache::normalizeDn(i->second.dn.c_str()));
+            i->second.attrs->deref(nullptr);
+            i->second.dn = dn;
+            i->second.attrs = attrs;
+            type = "modify";
+        }
+        dns[QoreLdapSearchCache::normalizeDn(dn)] = uuid;
+        indexIntern(uuid, attrs, true);
+        events.push_back({type, uuid, dn, attrs->hashRefSelf()});
+        ++changes;
+    }
+
+    // removes entries not reported as present in the present phase; the lock must be held
+    DLLLOCAL void sweepIntern(event_list_t& events) {
+        for (entry_map_t::iterator i = entries.begin(), e = entries.end(); i != e;) {
+            entry_map_t::iterator ci = i++;
+            if (present.find(ci->first) == present.end())
+                removeIntern(ci, events);
+        }
+        present.clear();
+    }
+
+    // ends the refresh phase; the lock must be held
+    DLLLOCAL void refreshDoneIntern(bool sweep, event_list_t& events) {
+        if (sweep && in_refresh)
+            sweepIntern(events);
+        else
+            present.clear();
+        in_refresh = false;
+        refreshed = true;
+    }
+
+    // reports the given events to the callback and releases them; returns -1 if an exception was raised
+    /** if an exception has already been raised, the events are only released
+    */
+    DLLLOCAL int deliver(event_list_t& events, ExceptionSink* xsink) {
+        int rc = *xsink ? -1 : 0;
+        for (auto& i : events) {
+            if (cb && !rc) {
+                ReferenceHolder<QoreHashNode> h(new QoreHashNode, xsink);
+                h->setKeyValue("type", new QoreStringNode(i.type), xsink);
+                h->setKeyValue("uuid", formatUuid(i.uuid), xsink);
+                h->setKeyValue("dn", new QoreStringNode(i.dn.c_str(), QCS_UTF8), xsink);
+                if (strcmp(i.type, "delete"))
+                    h->setKeyValue("attributes", i.attrs->hashRefSelf(), xsink);
+
+                ReferenceHolder<QoreListNode> args(new QoreListNode(autoTypeInfo), xsink);
+                args->push(h.release(), xsink);
+                ValueHolder rv(cb->execValue(*args, xsink), xsink);
+                if (*xsink)
+                    rc = -1;
+            }
+            i.attrs->deref(nullptr);
+        }
+        events.clear();
+        return rc;
+    }
+
+    // processes a search entry with the sync state control
+    DLLLOCAL int processEntry(LDAPMessage* msg, event_list_t& events, ExceptionSink* xsink) {
+        ReferenceHolder<QoreHashNode> entry(xsink);
+        std::string uuid, ck;
+        int state;
+        {
+            AutoLocker al(client->m);
+            if (client->getSyncStateIntern("sync", msg, state, uuid, ck, xsink))
+                return -1;
+            if (state == LDAP_SYNC_ADD || state == LDAP_SYNC_MODIFY) {
+                entry = client->makeEntryIntern(msg, xsink, &ss->sp.ropts);
+                if (!entry)
+                    return -1;
+            }
+        }
+
+        AutoLocker al(m);
+        switch (state) {
+            case LDAP_SYNC_PRESENT:
+                if (in_refresh)
+                    present.insert(uuid);
+                break;
+
+            case LDAP_SYNC_ADD:
+            case LDAP_SYNC_MODIFY: {
+                if (in_refresh)
+                    present.insert(uuid);
+                const QoreStringNode* dn = entry->getKeyValue("dn").get<const QoreStringNode>();
+                QoreHashNode* attrs = entry->getKeyValue("attributes").get<QoreHashNode>()->hashRefSelf();
+                updateIntern(uuid, dn->c_str(), attrs, events);
+                break;
+            }
+
+            case LDAP_SYNC_DELETE: {
+                entry_map_t::iterator i = entries.find(uuid);
+                if (i != entries.end())
+                    removeIntern(i, events);
+                break;
+            }
+
+            default:
+                return QoreLdapClient::syncError("unknown sync state", xsink);
+        }
+        if (!ck.empty())
+            cookie = ck;
+        return 0;
+    }
+
+    // processes a sync info intermediate response
+    DLLLOCAL int processInfo(LDAPMessage* msg, event_list_t& events, ExceptionSink* xsink) {
+        QoreLdapSyncInfo info;
+        {
+            AutoLocker al(client->m);
+            int rc = client->getSyncInfoIntern("sync", msg, info, xsink);
+            // other intermediate responses are ignored
+            if (rc <= 0)
+                return rc;
+        }
+
+        AutoLocker al(m);
+        switch (info.tag) {
+            case LDAP_TAG_SYNC_REFRESH_DELETE:
+            case LDAP_TAG_SYNC_REFRESH_PRESENT:
+                if (info.refresh_done)
+                    refreshDoneIntern(info.tag == LDAP_TAG_SYNC_REFRESH_PRESENT, events);
+                break;
+
+            case LDAP_TAG_SYNC_ID_SET:
+                for (auto& uuid : info.uuids) {
+                    if (!info.refresh_deletes) {
+                        if (in_refresh)
+                            present.insert(uuid);
+                        continue;
+                    }
+                    entry_map_t::iterator i = entries.find(uuid);
+                    if (i != entries.end())
+                        removeIntern(i, events);
+                }
+                break;
+
+            default:
+                break;
+        }
+        if (!info.cookie.empty())
+            cookie = info.cookie;
+        return 0;
+    }
+
+    // processes the search result with the sync done control
+    /** @return 0 if the synchronization is complete, 1 if a full reload is required, -1 if an exception was raised
+    */
+    DLLLOCAL int processDone(LDAPMessage* msg, event_list_t& events, ExceptionSink* xsink) {
+        AutoLocker al(client->m);
+        QoreLdapParseResultHelper prh("sync", "ldap_search_ext", client, msg, xsink, true, false);
+        if (*xsink)
+            return -1;
+        if (prh.getError() == LDAP_SYNC_REFRESH_REQUIRED)
+            return 1;
+        if (prh.check())
+            return -1;
+
+        std::string ck;
+        bool refresh_deletes = false;
+        LDAPControl* ctrl = prh.findControl(LDAP_CONTROL_SYNC_DONE);
+        if (ctrl) {
+            // syncDoneValue ::= SEQUENCE { cookie syncCookie OPTIONAL, refreshDeletes BOOLEAN DEFAULT FALSE }
+            BerElement* ber = ber_init(&ctrl->ldctl_value);
+            if (!ber) {
+                xsink->outOfMemory();
+                return -1;
+            }
+            ON_BLOCK_EXIT(ber_free, ber, 1);
+            if (ber_scanf(ber, "{") == LBER_ERROR)
+                return QoreLdapClient::syncError("invalid sync done control", xsink);
+            QoreLdapClient::getBerOptionalString(ber, LDAP_TAG_SYNC_COOKIE, ck);
+            refresh_deletes = QoreLdapClient::getBerOptionalBool(ber, LDAP_TAG_REFRESHDELETES, false);
+        }
+
+        AutoLocker al2(m);
+        refreshDoneIntern(!refresh_deletes, events);
+        if (!ck.empty())
+            cookie = ck;
+        return 0;
+    }
+
+    // runs one synchronization search
+    /** @return 0 if the synchronization is complete or was stopped, 1 if a full reload is required, -1 if an
+        exception was raised
+    */
+    DLLLOCAL int syncOnceIntern(ExceptionSink* xsink, int mode, int my_timeout_ms) {
+        std::string ck;
+        {
+            AutoLocker al(m);
+            ck = cookie;
+            present.clear();
+            in_refresh = true;
+        }
+        if (client->syncStart(xsink, *ss, "sync", mode, ck))
+            return -1;
+
+        event_list_t events;
+        int idle_ms = 0;
+        while (true) {
+            bool stopped;
+            {
+                AutoLocker al(m);
+                stopped = stop_sync;
+            }
+            if (stopped) {
+                client->searchEnd(*ss, xsink);
+                return 0;
+            }
+
+            LDAPMessage* msg = 0;
+            int slice = my_timeout_ms && my_timeout_ms < QORE_LDAP_SYNC_POLL_MS ? my_timeout_ms : QORE_LDAP_SYNC_POLL_MS;
+            int rc = client->streamNext(xsink, *ss, "sync", slice, msg);
+            if (rc < 0) {
+                client->searchEnd(*ss, xsink);
+                return -1;
+            }
+            if (!rc) {
+                // a timeout only applies to the refresh phase; persistent synchronizations wait indefinitely
+                idle_ms += slice;
+                if (mode == LDAP_SYNC_REFRESH_ONLY && my_timeout_ms && idle_ms >= my_timeout_ms) {
+                    client->searchEnd(*ss, xsink);
+                    client->doLdapError("sync", "ldap_search_ext", LDAP_TIMEOUT, xsink);
+                    return -1;
+                }
+                continue;
+            }
+            idle_ms = 0;
+            ON_BLOCK_EXIT(ldap_msgfree, msg);
+
+            switch (ldap_msgtype(msg)) {
+                case LDAP_RES_SEARCH_ENTRY:
+                    rc = processEntry(msg, events, xsink);
+                    break;
+                case LDAP_RES_INTERMEDIATE:
+                    rc = processInfo(msg, events, xsink);
+                    break;
+                case LDAP_RES_SEARCH_RESULT:
+                    rc = processDone(msg, events, xsink);
+                    if (deliver(events, xsink))
+                        return -1;
+                    return rc;
+                default:
+                    // search references are ignored
+                    rc = 0;
+                    break;
+            }
+            if (rc || deliver(events, xsink)) {
+                deliver(events, xsink);
+                client->searchEnd(*ss, xsink);
+                return -1;
+            }
+        }
+    }
+
+    // runs the synchronization with the given mode until it is complete or stopped
+    DLLLOCAL int64 syncIntern(ExceptionSink* xsink, const char* meth, int mode, int my_timeout_ms) {
+        {
+            AutoLocker al(m);
+            if (destroyed) {
+                xsink->raiseException("LDAP-SYNC-ERROR", "LdapSyncConsumer::%s(): the object has already been destroyed", meth);
+                return -1;
+            }
+            if (tid) {
+                xsink->raiseException("LDAP-SYNC-ERROR", "LdapSyncConsumer::%s(): a synchronization is already in progress in TID %d", meth, tid);
+                return -1;
+            }
+            tid = q_gettid();
+            stop_sync = false;
+            changes = 0;
+        }
+        // the timeout for the refresh phase defaults to the client's default timeout
+        if (mode == LDAP_SYNC_REFRESH_ONLY && !my_timeout_ms)
+            my_timeout_ms = client->timeout_ms;
+
+        int rc;
+        while (true) {
+            rc = syncOnceIntern(xsink, mode, my_timeout_ms);
+            if (rc != 1)
+                break;
+            // the server cannot resume from the cookie; reload the content from scratch and remove entries not
+            // reported as present
+            AutoLocker al(m);
+            cookie.clear();
+        }
+
+        SafeLocker sl(m);
+        tid = 0;
+        cond.broadcast();
+        int64 n = changes;
+        // the object was destroyed in a callback
+        if (destroyed)
+            cleanupIntern(sl, xsink);
+        return rc ? -1 : n;
+    }
+
+    // releases all resources; the lock must be held and is released
+    DLLLOCAL void cleanupIntern(SafeLocker& sl, ExceptionSink* xsink) {
+        if (ss) {
+            ss->del(xsink);
+            ss = 0;
+        }
+        for (auto& i : entries)
+            i.second.attrs->deref(xsink);
+        entries.clear();
+        dns.clear();
+        index.clear();
+        QoreLdapClient* l = client;
+        client = 0;
+        ResolvedCallReferenceNode* c = cb;
+        cb = 0;
+        sl.unlock();
+
+        if (l)
+            l->deref(xsink);
+        if (c)
+            c->deref(xsink);
+    }
+
+public:
+    DLLLOCAL QoreLdapSyncConsumer(QoreLdapClient* l, const QoreHashNode& h, const ResolvedCallReferenceNode* callback, const QoreHashNode* opts, ExceptionSink* xsink) : client(l), ss(new QoreLdapSearchStream(h, xsink)), cb(callback ? callback->refRefSelf() : nullptr) {
+        client->ref();
+        if (ss->parse())
+            return;
+        // results are always returned as hashes of entries
+        ss->sp.ropts.format = QLF_HASH;
+
+        if (!opts)
+            return;
+
+        QoreValue v = opts->getKeyValue("index");
+        if (!v.isNothing()) {
+            if (v.getType() == NT_STRING) {
+                index[QoreLdapResultOpts::getKey(v.get<const QoreStringNode>()->c_str())];
+            } else if (v.getType() == NT_LIST) {
+                ConstListIterator li(v.get<const QoreListNode>());
+                while (li.next()) {
+                    QoreStringValueHelper str(li.getValue(), QCS_UTF8, xsink);
+                    if (*xsink)
+                        return;
+                    index[QoreLdapResultOpts::getKey(str->c_str())];
+                }
+            } else {
+                xsink->raiseException("LDAP-SYNC-ERROR", "the 'index' option has type '%s'; expecting 'string' or 'list'", v.getTypeName());
+                return;
+            }
+        }
+    }
+
+    DLLLOCAL ~QoreLdapSyncConsumer() {
+        assert(!client);
+        assert(!ss);
+        assert(!cb);
+        assert(entries.empty());
+    }
+
+    DLLLOCAL int destructor(ExceptionSink* xsink) {
+        SafeLocker sl(m);
+        if (destroyed)
+            return 0;
+        destroyed = true;
+        // stop any synchronization in progress and wait for it to end; if called in the synchronizing thread (i.e.
+        // in a callback), then resources are released when the synchronization ends
+        if (tid) {
+            stop_sync = true;
+            if (tid == q_gettid())
+                return 0;
+            while (tid)
+                cond.wait(m);
+        }
+        cleanupIntern(sl, xsink);
+        return 0;
+    }
+
+    // runs a refreshOnly synchronization and returns the number of changes applied or -1 if an exception was raised
+    DLLLOCAL int64 refresh(ExceptionSink* xsink, int my_timeout_ms) {
+        return syncIntern(xsink, "refresh", LDAP_SYNC_REFRESH_ONLY, my_timeout_ms);
+    }
+
+    // runs a refreshAndPersist synchronization until stopped; returns -1 if an exception was raised
+    DLLLOCAL int64 run(ExceptionSink* xsink) {
+        return syncIntern(xsink, "run", LDAP_SYNC_REFRESH_AND_PERSIST, 0);
+    }
+
+    // stops the synchronization in progress, if any
+    DLLLOCAL void stop() {
+        AutoLocker al(m);
+        if (tid)
+            stop_sync = true;
+    }
+
+    DLLLOCAL QoreHashNode* getEntry(const QoreStringNode* dn, ExceptionSink* xsink) const {
+        QoreStringValueHelper str(dn, QCS_UTF8, xsink);
+        if (*xsink)
+            return 0;
+        AutoLocker al(m);
+        dn_map_t::const_iterator i = dns.find(QoreLdapSearchCache::normalizeDn(str->c_str()));
+        if (i == dns.end())
+            return 0;
+        entry_map_t::const_iterator ei = entries.find(i->second);
+        assert(ei != entries.end());
+        return makeEntry(ei->second);
+    }
+
+    DLLLOCAL QoreListNode* findEntries(const QoreStringNode* attr, const QoreStringNode* value, ExceptionSink* xsink) const {
+        QoreStringValueHelper astr(attr, QCS_UTF8, xsink);
+        if (*xsink)
+            return 0;
+        QoreStringValueHelper vstr(value, QCS_UTF8, xsink);
+        if (*xsink)
+            return 0;
+
+        ReferenceHolder<QoreListNode> rv(new QoreListNode(autoTypeInfo), xsink);
+        AutoLocker al(m);
+        index_map_t::const_iterator i = index.find(QoreLdapResultOpts::getKey(astr->c_str()));
+        if (i == index.end()) {
+            xsink->raiseException("LDAP-SYNC-ERROR", "attribute '%s' is not indexed", astr->c_str());
+            return 0;
+        }
+        value_map_t::const_iterator vi = i->second.find(std::string(vstr->c_str(), vstr->size()));
+        if (vi == i->second.end())
+            return rv.release();
+        for (auto& uuid : vi->second) {
+            entry_map_t::const_iterator ei = entries.find(uuid);
+            assert(ei != entries.end());
+            rv->push(makeEntry(ei->second), xsink);
+        }
+        return rv.release();
+    }
+
+    DLLLOCAL QoreHashNode* getEntries() const {
+        QoreHashNode* h = new QoreHashNode;
+        AutoLocker al(m);
+        for (auto& i : entries)
+            h->setKeyValue(i.second.dn.c_str(), i.second.attrs->hashRefSelf(), nullptr);
+        return h;
+    }
+
+    DLLLOCAL int64 size() const {
+        AutoLocker al(m);
+        return (int64)entries.size();
+    }
+
+    DLLLOCAL bool isRefreshed() const {
+        AutoLocker al(m);
+        return refreshed;
+    }
+
+    DLLLOCAL BinaryNode* getCookie() const {
+        AutoLocker al(m);
+        if (cookie.empty())
+            return 0;
+        BinaryNode* b = new BinaryNode;
+        b->append(cookie.data(), cookie.size());
+        return b;
+    }
+};
+
+#endif
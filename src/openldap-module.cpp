@@ -46,6 +46,9 @@ DLLEXPORT qore_license_t qore_module_license = QL_LGPL;
 DLLEXPORT char qore_module_license_str[] = "MIT";
 
 DLLLOCAL QoreClass* initLdapClientClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initLdapSearchIteratorClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initLdapClientPoolClass(QoreNamespace& ns);
+DLLLOCAL QoreClass* initLdapSyncConsumerClass(QoreNamespace& ns);
 
 // modify action map
 ModMap modmap;
@@ -63,6 +66,9 @@ static QoreStringNode* openldap_module_init() {
    qore_set_library_cleanup_options(QLO_DISABLE_OPENSSL_CLEANUP);
 
    OLNS.addSystemClass(initLdapClientClass(OLNS));
+   OLNS.addSystemClass(initLdapSearchIteratorClass(OLNS));
+   OLNS.addSystemClass(initLdapClientPoolClass(OLNS));
+   OLNS.addSystemClass(initLdapSyncConsumerClass(OLNS));
 
    return 0;
 }
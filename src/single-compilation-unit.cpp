@@ -1,2 +1,5 @@
 #include "openldap-module.cpp"
 #include "QC_LdapClient.cpp"
+#include "QC_LdapSearchIterator.cpp"
+#include "QC_LdapClientPool.cpp"
+#include "QC_LdapSyncConsumer.cpp"
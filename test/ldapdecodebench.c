@@ -0,0 +1,231 @@
+/* -*- mode: c; indent-tabs-mode: nil -*- */
+/*
+    ldapdecodebench.c
+
+    Qore Programming Language
+
+    Copyright 2012 - 2026 Qore Technologies, s.r.o.
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/* counts the memory allocations made by libldap and liblber while decoding search result entries, once as the
+   openldap module decoded them before version 1.3 (ldap_get_dn(), ldap_first_attribute() / ldap_next_attribute(),
+   and ldap_get_values_len()) and once as it decodes them now (ldap_get_dn_ber() and ldap_get_attribute_ber() with
+   the values left in the message buffer)
+
+   the Qore values built from each entry are the same in both cases, so they are not part of the comparison
+
+   build with (glibc only, because the allocation functions are interposed with glibc's internal entry points):
+       cc -O2 -o ldapdecodebench ldapdecodebench.c -lldap -llber
+
+   example:
+       ./ldapdecodebench -H ldap://localhost -b dc=example,dc=com "(objectClass=*)"
+*/
+
+#include <ldap.h>
+#include <lber.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// glibc's allocation functions; the functions below replace malloc() and friends for libldap and liblber
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+
+// the number of allocations made while counting is enabled
+static unsigned long allocs = 0;
+static int counting = 0;
+
+void* malloc(size_t size) {
+    if (counting)
+        ++allocs;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    if (counting)
+        ++allocs;
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size) {
+    if (counting)
+        ++allocs;
+    return __libc_realloc(p, size);
+}
+
+// totals for one decoding method
+struct totals {
+    unsigned long allocs;
+    unsigned long attributes;
+    unsigned long values;
+    unsigned long bytes;
+};
+
+// decodes the entry like the module did before version 1.3
+static void decode_old(LDAP* ld, LDAPMessage* e, struct totals* t) {
+    BerElement* ber;
+    char* attr = ldap_first_attribute(ld, e, &ber);
+    for (; attr; attr = ldap_next_attribute(ld, e, ber)) {
+        struct berval** vals = ldap_get_values_len(ld, e, attr);
+        ++t->attributes;
+        if (vals) {
+            for (unsigned i = 0; vals[i]; ++i) {
+                ++t->values;
+                t->bytes += vals[i]->bv_len;
+            }
+            ber_bvecfree(vals);
+        }
+        ldap_memfree(attr);
+    }
+    if (ber)
+        ber_free(ber, 0);
+
+    char* dn = ldap_get_dn(ld, e);
+    ldap_memfree(dn);
+}
+
+// decodes the entry like QoreLdapEntryDecoder
+static void decode_new(LDAP* ld, LDAPMessage* e, struct totals* t) {
+    BerElement* ber = NULL;
+    struct berval dn;
+    if (ldap_get_dn_ber(ld, e, &ber, &dn) != LDAP_SUCCESS) {
+        if (ber)
+            ber_free(ber, 0);
+        return;
+    }
+
+    struct berval attr;
+    BerVarray vals = NULL;
+    while (ldap_get_attribute_ber(ld, e, ber, &attr, &vals) == LDAP_SUCCESS && attr.bv_val) {
+        ++t->attributes;
+        if (vals) {
+            for (unsigned i = 0; vals[i].bv_val; ++i) {
+                ++t->values;
+                t->bytes += vals[i].bv_len;
+            }
+            ber_memfree(vals);
+            vals = NULL;
+        }
+    }
+    if (vals)
+        ber_memfree(vals);
+    ber_free(ber, 0);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-H uri] [-D binddn] [-w passwd] [-b basedn] [-s base|one|sub] [-Z] [filter [attributes...]]\n", name);
+    exit(1);
+}
+
+static void print_totals(const char* name, const struct totals* t, unsigned long entries) {
+    printf("%-4s decoding: %lu allocation(s), %.2f per entry, %.2f per attribute (%lu attributes, %lu values, %lu bytes)\n",
+        name, t->allocs, entries ? (double)t->allocs / entries : 0.0, t->attributes ? (double)t->allocs / t->attributes : 0.0,
+        t->attributes, t->values, t->bytes);
+}
+
+int main(int argc, char* argv[]) {
+    const char* uri = "ldap://localhost:389";
+    const char* binddn = NULL;
+    const char* passwd = NULL;
+    const char* base = NULL;
+    int scope = LDAP_SCOPE_SUBTREE;
+    int starttls = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "H:D:w:b:s:Zh")) != -1) {
+        switch (c) {
+            case 'H': uri = optarg; break;
+            case 'D': binddn = optarg; break;
+            case 'w': passwd = optarg; break;
+            case 'b': base = optarg; break;
+            case 's':
+                if (!strcmp(optarg, "base"))
+                    scope = LDAP_SCOPE_BASE;
+                else if (!strcmp(optarg, "one"))
+                    scope = LDAP_SCOPE_ONELEVEL;
+                else if (!strcmp(optarg, "sub"))
+                    scope = LDAP_SCOPE_SUBTREE;
+                else
+                    usage(argv[0]);
+                break;
+            case 'Z': starttls = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    const char* filter = optind < argc ? argv[optind++] : "(objectClass=*)";
+    char** attrs = optind < argc ? argv + optind : NULL;
+
+    LDAP* ld;
+    int rc = ldap_initialize(&ld, uri);
+    if (rc != LDAP_SUCCESS) {
+        fprintf(stderr, "ldap_initialize(%s): %s\n", uri, ldap_err2string(rc));
+        return 1;
+    }
+    int version = LDAP_VERSION3;
+    ldap_set_option(ld, LDAP_OPT_PROTOCOL_VERSION, &version);
+    if (starttls && (rc = ldap_start_tls_s(ld, NULL, NULL)) != LDAP_SUCCESS) {
+        fprintf(stderr, "ldap_start_tls_s(): %s\n", ldap_err2string(rc));
+        return 1;
+    }
+
+    struct berval cred;
+    cred.bv_val = (char*)(passwd ? passwd : "");
+    cred.bv_len = strlen(cred.bv_val);
+    rc = ldap_sasl_bind_s(ld, binddn, LDAP_SASL_SIMPLE, &cred, NULL, NULL, NULL);
+    if (rc != LDAP_SUCCESS) {
+        fprintf(stderr, "ldap_sasl_bind_s(): %s\n", ldap_err2string(rc));
+        return 1;
+    }
+
+    LDAPMessage* res;
+    rc = ldap_search_ext_s(ld, base, scope, filter, attrs, 0, NULL, NULL, NULL, LDAP_NO_LIMIT, &res);
+    if (rc != LDAP_SUCCESS && rc != LDAP_SIZELIMIT_EXCEEDED) {
+        fprintf(stderr, "ldap_search_ext_s(): %s\n", ldap_err2string(rc));
+        return 1;
+    }
+
+    // each entry is decoded both ways, so both methods see exactly the same messages
+    struct totals old_t, new_t;
+    memset(&old_t, 0, sizeof old_t);
+    memset(&new_t, 0, sizeof new_t);
+    unsigned long entries = 0;
+    for (LDAPMessage* e = ldap_first_entry(ld, res); e; e = ldap_next_entry(ld, e)) {
+        ++entries;
+
+        allocs = 0;
+        counting = 1;
+        decode_old(ld, e, &old_t);
+        counting = 0;
+        old_t.allocs += allocs;
+
+        allocs = 0;
+        counting = 1;
+        decode_new(ld, e, &new_t);
+        counting = 0;
+        new_t.allocs += allocs;
+    }
+    ldap_msgfree(res);
+    ldap_unbind_ext_s(ld, NULL, NULL);
+
+    printf("%lu entries\n", entries);
+    print_totals("old", &old_t, entries);
+    print_totals("new", &new_t, entries);
+    return 0;
+}